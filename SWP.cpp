@@ -0,0 +1,121 @@
+//
+// File: SWP.cpp
+//
+// Author: Hamza Sultan Khan Niazi
+//
+// Description: The C interface of SWP.h, over the engine of SWP.hpp built
+// for the largest payload and window SWP.h allows, CRC-16 checks and
+// either I/O backend.  Programs written in C link with this as they did
+// with the C module it replaces.
+//
+
+#include "SWP.hpp"
+
+// the engine behind the C interface
+typedef Swp<SWP_MAX_PAYLOAD, 128, SWP_CheckCRC16, SWP_IoAny> SWP_engine;
+static SWP_engine SWP_default;
+
+int SWP_sendInit (char *hostname, short portNum, int WindowSize)
+{
+  return SWP_default.SWP_sendInit (hostname,portNum,WindowSize);
+}
+
+void SWP_send (char *buf, int length)
+{
+  SWP_default.SWP_send (buf,length);
+}
+
+void SWP_sendNoCopy (const char *buf, int length)
+{
+  SWP_default.SWP_sendNoCopy (buf,length);
+}
+
+void SWP_flush (void)
+{
+  SWP_default.SWP_flush ();
+}
+
+int SWP_setFEC (int blockSize, int numParity)
+{
+  return SWP_default.SWP_setFEC (blockSize,numParity);
+}
+
+int SWP_setPacing (long bytesPerSec, int maxBurst)
+{
+  return SWP_default.SWP_setPacing (bytesPerSec,maxBurst);
+}
+
+int SWP_setIntegrity (int policy)
+{
+  return SWP_default.SWP_setIntegrity (policy);
+}
+
+int SWP_setPayloadSize (int size, int probe)
+{
+  return SWP_default.SWP_setPayloadSize (size,probe);
+}
+
+int SWP_setStripes (int numStripes)
+{
+  return SWP_default.SWP_setStripes (numStripes);
+}
+
+void SWP_setCompression (int on)
+{
+  SWP_default.SWP_setCompression (on);
+}
+
+int SWP_setCoalescing (int deadlineUsecs)
+{
+  return SWP_default.SWP_setCoalescing (deadlineUsecs);
+}
+
+int SWP_setBackend (int backend)
+{
+  return SWP_default.SWP_setBackend (backend);
+}
+
+void SWP_setSharedMemory (int on)
+{
+  SWP_default.SWP_setSharedMemory (on);
+}
+
+int SWP_setSendQueue (int numMessages)
+{
+  return SWP_default.SWP_setSendQueue (numMessages);
+}
+
+int SWP_setTrace (const char *fileName, int eventsPerThread)
+{
+  return SWP_default.SWP_setTrace (fileName,eventsPerThread);
+}
+
+int SWP_setResumeToken (struct SWP_resumeToken *token)
+{
+  return SWP_default.SWP_setResumeToken (token);
+}
+
+int SWP_getResumeToken (struct SWP_resumeToken *token)
+{
+  return SWP_default.SWP_getResumeToken (token);
+}
+
+int SWP_recvInit (short portNum, int WindowSize)
+{
+  return SWP_default.SWP_recvInit (portNum,WindowSize);
+}
+
+void SWP_recv (char *buf, int *length)
+{
+  SWP_default.SWP_recv (buf,length);
+}
+
+int SWP_getPeer (char *hostname, int size)
+{
+  return SWP_default.SWP_getPeer (hostname,size);
+}
+
+void SWP_getStats (struct SWP_stats *stats)
+{
+  SWP_default.SWP_getStats (stats);
+}
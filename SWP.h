@@ -6,23 +6,85 @@
 // Description: This is a simple implementation of reliable transmission
 // that uses the sliding window protocol.
 // UDP datagrams are used to send data packets and acknowledgements.
+// The protocol is implemented by the class template in SWP.hpp, and these
+// functions are its C interface, over the instantiation in SWP.cpp.
+//
+// Each session starts with a handshake in which the sender proposes a
+// window size, payload size and integrity policy and the receiver answers
+// with the ones to use.  The sender doesn't wait for the answer: the first
+// few frames go out straight after the handshake.  A receiver has one
+// session at a time: while its sender is still sending, frames from any
+// other sender are dropped, and that sender's handshake is resent until
+// the session's sender has gone quiet or it gives up.
 //
 // The following functions are defined:
 //    SWP_sendInit (char *hostname,int portNum)
 //    SWP_send (char *buf, int length)
+//    SWP_sendNoCopy (const char *buf, int length)
 //    SWP_flush (void);
+//    SWP_setFEC (int blockSize, int numParity)
+//    SWP_setPacing (long bytesPerSec, int maxBurst)
+//    SWP_setIntegrity (int policy)
+//    SWP_setPayloadSize (int size, int probe)
+//    SWP_setStripes (int numStripes)
+//    SWP_setCompression (int on)
+//    SWP_setCoalescing (int deadlineUsecs)
+//    SWP_setBackend (int backend)
+//    SWP_setSharedMemory (int on)
+//    SWP_setSendQueue (int numMessages)
+//    SWP_setTrace (const char *fileName, int eventsPerThread)
+//    SWP_setResumeToken (struct SWP_resumeToken *token)
+//    SWP_getResumeToken (struct SWP_resumeToken *token)
 //
 //    SWP_recvInit (int portNum)
 //    SWP_recv (char *buf, int *length)
+//    SWP_getPeer (char *hostname, int size)
+//
+//    SWP_getStats (struct SWP_stats *stats)
 
 #ifndef _SWP_H_
 #define _SWP_H_
 
+// integrity policies for SWP_setIntegrity
+#define SWP_CHECK_NONE   0   // no check; rely on UDP's checksum
+#define SWP_CHECK_CRC16  1   // CRC-16 (the default)
+#define SWP_CHECK_CRC32C 2   // CRC-32C, in hardware where available
+#define SWP_CHECK_HASH64 3   // fast 64 bit hash
+
+// payload sizes.  A frame carries at most SWP_MAX_PAYLOAD bytes, which
+// fills a 9000 byte jumbo frame; unless SWP_setPayloadSize says otherwise
+// it carries at most SWP_DEFAULT_PAYLOAD.
+#define SWP_MAX_PAYLOAD 8956
+#define SWP_DEFAULT_PAYLOAD 1024
+
+// largest number of stripes a session may be spread over
+#define SWP_MAX_STRIPES 8
+
+// I/O backends for SWP_setBackend
+#define SWP_BACKEND_SOCKETS 0  // SIGIO and a system call per datagram
+#define SWP_BACKEND_URING   1  // io_uring, where the kernel has it
+
+// the parameters of a session, and the token with which a sender may
+// resume a session with the same receiver without negotiating again
+#define SWP_TOKEN_SIZE 8
+struct SWP_resumeToken {
+  int windowSize;
+  int payloadSize;
+  int checkPolicy;
+  int stripes;
+  int compress;           // true iff data frames may be compressed
+  unsigned char token[SWP_TOKEN_SIZE];
+};
+
 int SWP_sendInit (char *hostname, short portNum, int WindowSize);
 // initializes the SWP protocol so that messags subsequently sent using
 // SWP_send will be sent to the SWP protocol running on hostname using UDP
 // port portnum.  The sending window size is WindowSize, which must be
-// between 1 and 128 (inclusive).
+// between 1 and 128 (inclusive); the receiver may agree to a smaller one.
+// The handshake is sent before SWP_sendInit returns.  If hostname is this
+// host, and the receiver on portnum offers a shared memory channel, as
+// every receiver does unless SWP_setSharedMemory turned it off, frames go
+// through it instead of UDP, and nothing else changes.
 //
 // A negative return value indicates an error.
 
@@ -31,21 +93,197 @@ void SWP_send (char *buf, int length);
 // bytes will be sent, starting at buf.  SWP_send may return before the 
 // message is sent, but SWP_send will make a copy of the message so the caller
 // can change the buffer.  Currently there is no way for the caller to verify
-// that the message was successfully sent.
+// that the message was successfully sent.  A message longer than the
+// session's payload size is sent as several, which are received
+// separately.
+
+void SWP_sendNoCopy (const char *buf, int length);
+// as SWP_send, except that no copy of the message is made: frames are sent,
+// and resent, straight from buf.  The caller must leave the length bytes at
+// buf alone until SWP_flush returns.  Meant for data that is already in
+// memory for good, such as a memory mapped file.
 
 void SWP_flush (void);
 // does not return until all previously sent message have been successfully
 // delivered
 
+int SWP_setFEC (int blockSize, int numParity);
+// turns on forward error correction: every blockSize frames sent are
+// followed by numParity parity frames, from which the receiver can rebuild
+// up to numParity lost frames of the block without waiting for them to be
+// resent.  With one parity frame the parity is a plain XOR; with more it
+// is a Reed-Solomon style code.  blockSize must be between 1 and 128 and is
+// limited to the window size; numParity must be between 1 and 8.  A
+// blockSize of 0 turns forward error correction off, which is the default.
+// The receiver needs no setup.
+//
+// A negative return value indicates an error.
+
+int SWP_setPacing (long bytesPerSec, int maxBurst);
+// paces transmissions through a token bucket rather than sending frames
+// back to back whenever the window opens.  Frames go out at bytesPerSec
+// or, if bytesPerSec is 0, at one window per measured round trip time
+// (frames are not paced until the first round trip has been measured).
+// At most maxBurst frames are sent back to back.  A maxBurst of 0 turns
+// pacing off, which is the default.
+//
+// A negative return value indicates an error.
+
+int SWP_setIntegrity (int policy);
+// chooses how frames are checked for transmission errors; policy is one of
+// the SWP_CHECK_* values above.  The sender proposes its policy in the
+// handshake, and the receiver's policy is the one used for the session.
+// The policy is carried in every frame, and frames and acks that weren't
+// sent under the session's policy are discarded.
+//
+// A negative return value indicates an error.
+
+int SWP_setPayloadSize (int size, int probe);
+// sets the largest payload, up to SWP_MAX_PAYLOAD, that we'll agree to in
+// the handshake; the session uses the smaller of the two ends' sizes.
+// If probe is nonzero the sender starts with frames of at most
+// SWP_DEFAULT_PAYLOAD bytes and probes the path, with don't fragment set,
+// for the largest payload that gets through, up to the agreed size.
+// Called before SWP_sendInit or SWP_recvInit.
+//
+// A negative return value indicates an error.
+
+int SWP_setStripes (int numStripes);
+// spreads the session over numStripes sockets, between 1 (the default)
+// and SWP_MAX_STRIPES, so that its packets can be spread over several NIC
+// queues and cores.  The sender's stripe i sends from a port of its own to
+// portNum+i, and the receiver listens on portNum to portNum+numStripes-1.
+// Each stripe but the first is served by a thread of its own.  The session
+// uses the smaller of the two ends' numbers of stripes.  Called before
+// SWP_sendInit or SWP_recvInit.
+//
+// A negative return value indicates an error.
+
+void SWP_setCompression (int on);
+// offers, at a sender, or agrees, at a receiver, to compress the payloads
+// of data frames with the built-in LZ compressor; both ends must turn it
+// on for the session to use it.  A frame that doesn't shrink is sent as it
+// is, so incompressible data costs only the time spent trying.  The
+// receiver decompresses each frame into its receive buffer.  Called before
+// SWP_sendInit or SWP_recvInit.
+
+int SWP_setCoalescing (int deadlineUsecs);
+// packs small messages handed to SWP_send into frames of their own, each
+// message preceded by its length, rather than sending a frame for each.
+// A frame goes out once the next message won't fit, or deadlineUsecs
+// microseconds (at most 1000000) after the first message in it was handed
+// over, whichever comes first; SWP_flush sends it at once.  The receiver
+// agrees unless it predates coalescing, and SWP_recv still returns the
+// messages one at a time.  Messages given to SWP_sendNoCopy, and ones too
+// big to share a frame, go out as usual, after any that were packed
+// before them.  0 turns coalescing off.  Called before SWP_sendInit.
+//
+// A negative return value indicates an error.
+
+int SWP_setBackend (int backend);
+// chooses how the sockets are served.  With SWP_BACKEND_URING, each end
+// serves its stripes through an io_uring: receives stay posted on all of
+// them, taken by a thread of the library's own, and the frames and
+// answers sent while the library's lock is held go to the kernel together
+// in one system call.  Big frames are sent without being copied where the
+// kernel can.  An end that can't have a ring, because the kernel is older
+// than 6.1 or SWP_setTrace was called, uses the sockets as usual, as does
+// a sender that goes through shared memory.  Either way the protocol is
+// the same, and the other end needn't use the same backend.  Called
+// before SWP_sendInit or SWP_recvInit.
+//
+// A negative return value indicates an error.
+
+void SWP_setSharedMemory (int on);
+// chooses whether frames between ends on the same host may go through
+// shared memory, as they do by default.  Turned off at a receiver, it
+// offers no channel; at a sender, it uses UDP even if one is offered.
+// Frames then take the sockets as they would between hosts, so stripes,
+// a ring and the kernel's stamps of frames sent are used on this host
+// too.  Called before SWP_sendInit or SWP_recvInit.
+
+int SWP_setSendQueue (int numMessages);
+// lets any number of threads call SWP_send, SWP_sendNoCopy and SWP_flush
+// at once.  Messages go on a lock-free queue of numMessages entries, a
+// power of two, and a thread of the library's own sends them in the order
+// they were queued; messages from one thread are therefore delivered in
+// the order that thread sent them.  SWP_send returns once the message is
+// queued, and waits only while the queue is full.  SWP_flush waits for
+// every message queued before it was called.  Called before SWP_sendInit.
+//
+// A negative return value indicates an error.
+
+int SWP_setTrace (const char *fileName, int eventsPerThread);
+// records an event for every data frame as it is handed to SWP_send, sent,
+// resent, stamped by the kernel as it leaves, acked, comes in at the
+// receiver and is handed over by SWP_recv.  Times are taken by the kernel
+// (SO_TIMESTAMPING) where it can.  Each thread keeps its last
+// eventsPerThread events, a power of two, and they are written to fileName
+// when the program exits; swptrace reads the traces of both ends and
+// breaks down where the time went.  Called before SWP_sendInit or
+// SWP_recvInit.
+//
+// A negative return value indicates an error.
+
+int SWP_setResumeToken (struct SWP_resumeToken *token);
+// called before SWP_sendInit to resume a session with a token obtained
+// from SWP_getResumeToken in an earlier session with the same receiver.
+// The session's parameters are used from the start, and a whole window of
+// frames may be sent before the handshake is answered.  If the receiver
+// doesn't accept the token it negotiates as usual.  A null token turns
+// resumption off.
+//
+// A negative return value indicates an error.
+
+int SWP_getResumeToken (struct SWP_resumeToken *token);
+// copies the parameters agreed on in the handshake, and the token with
+// which the session may be resumed, into token.  Returns 1 if the session
+// was resumed, 0 if it was negotiated, and a negative value if the
+// handshake hasn't been answered yet.
+
 int SWP_recvInit (short portNum,int WindowSize);
 // initializes the SWP protocol to receive messages on UDP port portnum.  The
 // receive window size is WindowSize, which must be between 1 and 128 
-// (inclusive).
+// (inclusive); a sender asking for a smaller one gets the smaller one.
 //
 // A negative return value indicates an error.
 
 void SWP_recv (char *buf, int *length);
 // receive a message using the SWP protocol.  On entry, buf is a pointer to
-// a buffer of at least length bytes.  On return length contains the number
-// of bytes actually read.
+// a buffer of at least length bytes, which must be at least the session's
+// payload size.  On return length contains the number of bytes actually
+// read.
+
+int SWP_getPeer (char *hostname, int size);
+// copies the address of the sender whose session we're receiving, in dots
+// and numbers, into the size byte buffer hostname, so that a process that
+// also calls SWP_sendInit can answer it.  A process may both send and
+// receive, each with a session of its own.
+//
+// A negative return value indicates that no session has started.
+
+struct SWP_stats {
+  long framesSent;          // data frames sent for the first time
+  long framesRetransmitted; // data frames resent after a timeout
+  long parityFramesSent;    // parity frames sent
+  long framesReceived;      // data frames received and accepted
+  long framesRecoveredFEC;  // data frames rebuilt from parity frames
+  long badFrames;           // frames discarded by the integrity check
+  long srttUsecs;           // smoothed round trip time, in microseconds
+  long payloadSize;         // largest payload in use
+  long framesCompressed;    // data frames sent compressed
+  long framesNotCompressed; // data frames sent as they were, not shrinking
+  long framesDecompressed;  // data frames received compressed
+  long bytesBeforeCompression; // payload bytes of those frames, as they
+  long bytesAfterCompression;  // were and compressed
+  long compressUsecs;       // time spent compressing and decompressing
+  long decompressUsecs;
+  long framesCoalesced;     // data frames sent packed with messages
+  long messagesCoalesced;   // and the messages packed in them
+  long sharedMemory;        // true iff frames sent go through shared memory
+  long ioUring;             // true iff an io_uring serves the sockets
+};
+
+void SWP_getStats (struct SWP_stats *stats);
+// copies the protocol statistics gathered so far into stats.
 #endif
@@ -0,0 +1,4651 @@
+//
+// File: SWP.hpp
+//
+// Author: Hamza Sultan Khan Niazi
+//
+// Description: Implements the sliding window protocol defined in SWP.h as
+// a header-only class template,
+//
+//    Swp<PayloadSize, WindowPow2, ChecksumPolicy, IoBackend>
+//
+// whose parameters are fixed when it is compiled:
+//    PayloadSize     the largest payload a frame carries, a multiple of 4
+//                    between SWP_DEFAULT_PAYLOAD and SWP_MAX_PAYLOAD
+//    WindowPow2      the largest window, a power of two; the buffers hold
+//                    twice that many frames, so a sequence number finds
+//                    its slot with a mask
+//    ChecksumPolicy  the integrity policy the engine asks for, one of the
+//                    SWP_Check types below.  Its check is called directly;
+//                    any other policy a peer settles on is still
+//                    understood, through CK_update.
+//    IoBackend       SWP_IoSockets or SWP_IoUring to build the engine for
+//                    that backend alone, or SWP_IoAny to choose with
+//                    SWP_setBackend
+// The buffers are sized from these, so an engine built for small frames or
+// windows takes only the memory it needs.  SWP.cpp offers the C interface
+// of SWP.h over one object of one instantiation.
+//
+// Each object is an engine, holding what was the file scope of a C module
+// in the layout it had, and a process may run as many as it likes, each
+// with a session of its own each way.  The engines share SIGIO, SIGALRM
+// and the interval timer through SWP_base, which passes each signal on to
+// all of them.  Two calls are only offered here:
+//    SWP_setExitOnFailure (int on)
+//    SWP_close (void)
+// since a program with one engine has no use for them.
+//
+#ifndef _SWP_HPP_
+#define _SWP_HPP_
+
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/ip.h> // IP_MTU_DISCOVER
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <stddef.h>     // offsetof
+#include <sys/file.h>   // for FASYNC
+#include <sys/time.h>   // timer
+#include <time.h>       // clock_gettime, nanosleep
+#include <errno.h>
+#include <stdint.h>     // uint64_t
+#include <stdio.h>
+#include <string.h>  // memmove
+#include <stdlib.h> // exit
+#include <unistd.h>     // getpid
+#include <pthread.h>    // stripe threads
+#include <semaphore.h>
+#include <atomic>       // the send queue
+#include <sched.h>      // sched_yield
+#ifdef __linux__
+#include <linux/net_tstamp.h> // SO_TIMESTAMPING
+#include <linux/errqueue.h>
+#endif
+extern "C" {
+#include "calcCRC16.h"
+#include "checksum.h"
+#include "unreliableSend.h"
+#include "fec.h"
+#include "trace.h"
+#include "lz.h"
+#include "shm.h"
+#include "uring.h"
+#include "SWP.h"
+}
+
+// integrity policies an engine may be built for.  check returns the check
+// value of a frame's header and payload.
+struct SWP_CheckNone {
+  static const int policy = SWP_CHECK_NONE;
+  static const int size = 0;
+  static unsigned long long check (const unsigned char *header, int headerSize,
+				   const unsigned char *payload, int payloadSize)
+  {
+    return 0;
+  }
+};
+
+struct SWP_CheckCRC16 {
+  static const int policy = SWP_CHECK_CRC16;
+  static const int size = 2;
+  static unsigned long long check (const unsigned char *header, int headerSize,
+				   const unsigned char *payload, int payloadSize)
+  {
+    struct CK_state st;
+
+    CK_begin (&st,CK_CRC16);
+    CK_updateCRC16 (&st,header,headerSize);
+    CK_updateCRC16 (&st,payload,payloadSize);
+    return st.value;
+  }
+};
+
+struct SWP_CheckCRC32C {
+  static const int policy = SWP_CHECK_CRC32C;
+  static const int size = 4;
+  static unsigned long long check (const unsigned char *header, int headerSize,
+				   const unsigned char *payload, int payloadSize)
+  {
+    struct CK_state st;
+
+    CK_begin (&st,CK_CRC32C);
+    CK_updateCRC32C (&st,header,headerSize);
+    CK_updateCRC32C (&st,payload,payloadSize);
+    return st.value ^ 0xffffffff;
+  }
+};
+
+struct SWP_CheckHash64 {
+  static const int policy = SWP_CHECK_HASH64;
+  static const int size = 8;
+  static unsigned long long check (const unsigned char *header, int headerSize,
+				   const unsigned char *payload, int payloadSize)
+  {
+    struct CK_state st;
+
+    CK_begin (&st,CK_HASH64);
+    CK_updateHash64 (&st,header,headerSize);
+    CK_updateHash64 (&st,payload,payloadSize);
+    return CK_endHash64 (&st);
+  }
+};
+
+// I/O backends an engine may be built for.  An engine built for one
+// backend has no other; SWP_IoAny starts on sockets and may be switched.
+struct SWP_IoSockets {
+  static const int backend = SWP_BACKEND_SOCKETS;
+  static const int fixed = 1;
+};
+
+struct SWP_IoUring {
+  static const int backend = SWP_BACKEND_URING;
+  static const int fixed = 1;
+};
+
+struct SWP_IoAny {
+  static const int backend = SWP_BACKEND_SOCKETS;
+  static const int fixed = 0;
+};
+
+// what the engines of a process share.  SIGIO, SIGALRM and the interval
+// timer belong to the process, so their handlers are here, and pass each
+// signal on to every engine there is; so does the hook that runs as the
+// process exits.  An engine is on SWP_engines from its first SWP_sendInit
+// or SWP_recvInit until SWP_close.  SWP_enginesMutex guards the list.  It
+// is only taken with SIGIO and SIGALRM blocked, and never while holding
+// the lock of an engine, so the handlers may take both.
+class SWP_base {
+protected:
+
+static constexpr int SWP_MAX_ENGINES = 256;
+static inline SWP_base *SWP_engines [SWP_MAX_ENGINES];
+static inline int SWP_numEngines;
+static inline pthread_mutex_t SWP_enginesMutex = PTHREAD_MUTEX_INITIALIZER;
+static inline int SWP_exitHooked;   // true once SWP_allExit is registered
+static inline int SWP_traceWanted;  // true iff the trace is written at exit
+
+int SWP_registered;                 // true iff we're on SWP_engines
+
+// what an engine does on each signal, and as the process exits
+virtual void SWP_SIGIO (int signalType) {}
+virtual void SWP_sendTimer (int signalType) {}
+virtual void SWP_exiting (void) {}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_register
+//
+///////////////////////////////////////////////////////////////////////////////
+int SWP_register (void)
+{
+  // put this engine on the list the handlers go through, if it isn't
+  // there already, and see that the exit hook will run
+  sigset_t oldsigset;
+  int ok = 1;
+
+  SWP_blockSignals (&oldsigset);
+  pthread_mutex_lock (&SWP_enginesMutex);
+  if (!SWP_registered && SWP_numEngines == SWP_MAX_ENGINES)
+    ok = 0;
+  else if (!SWP_registered)
+    {
+      SWP_engines[SWP_numEngines++] = this;
+      SWP_registered = 1;
+    }
+  SWP_hookExit ();
+  pthread_mutex_unlock (&SWP_enginesMutex);
+  pthread_sigmask (SIG_SETMASK,&oldsigset,0);
+  if (!ok)
+    {
+      printf ("Too many engines\n");
+      return -1;
+    }
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_unregister
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_unregister (void)
+{
+  // take this engine off the list.  No handler runs on it once we return.
+  sigset_t oldsigset;
+  int i;
+
+  SWP_blockSignals (&oldsigset);
+  pthread_mutex_lock (&SWP_enginesMutex);
+  for (i=0;SWP_registered && i<SWP_numEngines;i++)
+    if (SWP_engines[i] == this)
+      {
+	SWP_engines[i] = SWP_engines[--SWP_numEngines];
+	SWP_registered = 0;
+      }
+  pthread_mutex_unlock (&SWP_enginesMutex);
+  pthread_sigmask (SIG_SETMASK,&oldsigset,0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_wantTrace
+//
+///////////////////////////////////////////////////////////////////////////////
+static void SWP_wantTrace (void)
+{
+  // have the trace written as the process exits
+  sigset_t oldsigset;
+
+  SWP_blockSignals (&oldsigset);
+  pthread_mutex_lock (&SWP_enginesMutex);
+  SWP_traceWanted = 1;
+  SWP_hookExit ();
+  pthread_mutex_unlock (&SWP_enginesMutex);
+  pthread_sigmask (SIG_SETMASK,&oldsigset,0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_hookExit
+//
+///////////////////////////////////////////////////////////////////////////////
+static void SWP_hookExit (void)
+{
+  // register SWP_allExit, once.  Called with SWP_enginesMutex held.
+  if (!SWP_exitHooked)
+    atexit (SWP_allExit);
+  SWP_exitHooked = 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_blockSignals
+//
+///////////////////////////////////////////////////////////////////////////////
+static void SWP_blockSignals (sigset_t *oldsigset)
+{
+  // block the signals whose handlers use the engines
+  sigset_t sigset;
+
+  sigemptyset (&sigset);
+  sigaddset (&sigset,SIGALRM);
+  sigaddset (&sigset,SIGIO);
+  pthread_sigmask (SIG_BLOCK,&sigset,oldsigset);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_allSIGIO
+//
+///////////////////////////////////////////////////////////////////////////////
+static void SWP_allSIGIO (int signalType)
+{
+  // SIGIO doesn't say which socket is ready, so every engine looks
+  int i;
+
+  pthread_mutex_lock (&SWP_enginesMutex);
+  for (i=0;i<SWP_numEngines;i++)
+    SWP_engines[i]->SWP_SIGIO (signalType);
+  pthread_mutex_unlock (&SWP_enginesMutex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_allTimers
+//
+///////////////////////////////////////////////////////////////////////////////
+static void SWP_allTimers (int signalType)
+{
+  // the timer ticked for every engine
+  int i;
+
+  pthread_mutex_lock (&SWP_enginesMutex);
+  for (i=0;i<SWP_numEngines;i++)
+    SWP_engines[i]->SWP_sendTimer (signalType);
+  pthread_mutex_unlock (&SWP_enginesMutex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_allExit
+//
+///////////////////////////////////////////////////////////////////////////////
+static void SWP_allExit (void)
+{
+  // let every engine tidy up as the process exits, and write the trace.
+  // exit may be called from a handler, with SWP_enginesMutex and the lock
+  // of an engine held, so we take neither and only keep the handlers out.
+  sigset_t oldsigset;
+  int i;
+
+  SWP_blockSignals (&oldsigset);
+  for (i=0;i<SWP_numEngines;i++)
+    SWP_engines[i]->SWP_exiting ();
+  if (SWP_traceWanted)
+    TR_dump ();
+}
+};
+
+// the engine.  Its members are those of SWP.h, and what was private to
+// the C module is private to the class.
+template <int PayloadSize, int WindowPow2, class ChecksumPolicy,
+	  class IoBackend>
+class Swp : public SWP_base {
+
+// define constants and structs
+
+// largest payload a frame can carry.  The payload size of a session is
+// agreed in the handshake.
+static constexpr int SWP_PAYLOAD_SIZE = PayloadSize;
+static_assert (PayloadSize % 4 == 0,
+	       "payloads must be a multiple of 4 bytes");
+static constexpr int SWP_TIMEOUT_SECS = 0;
+static constexpr int SWP_TIMEOUT_USECS = 250000;
+static constexpr int SWP_MAX_TIMEOUTS = 25;
+
+// seconds the receiver's session stays with its sender after it was last
+// heard from.  Until then frames from any other sender, handshakes
+// included, are dropped; after it another sender may take the session
+// over.
+static constexpr int SWP_PEER_IDLE_SECS = 2;
+
+// buffer constants.  Sequence numbers run modulo SWP_SEQ_SPACE, and the
+// frame with sequence number seq is kept in slot SWP_slot(seq) of the
+// buffers; SWP_BUFSIZE is a power of two and at least twice the largest
+// window, so the frames in a window never share a slot, and at least a
+// word of bits in SWP_frameBits.  Both are powers of two, so wrapping a
+// sequence number with SWP_seq takes a mask rather than a division.
+static constexpr int SWP_BUFSIZE = WindowPow2 < 32 ? 64 : 2 * WindowPow2;
+static constexpr int SWP_SEQ_SPACE = 0x10000;
+static int SWP_slot (int seq)
+{
+  return seq & (SWP_BUFSIZE - 1);
+}
+static int SWP_seq (int seq)
+{
+  return seq & (SWP_SEQ_SPACE - 1);
+}
+
+// the largest window an engine may be built for.  A peer may propose a
+// window up to this, and is given the smaller of it and ours.
+static constexpr int SWP_WINDOW_LIMIT = SWP_SEQ_SPACE / 4;
+
+// kinds of frame
+static constexpr int SWP_DATA_FRAME = 0;
+static constexpr int SWP_PARITY_FRAME = 1;
+static constexpr int SWP_ACK_FRAME = 2;
+static constexpr int SWP_SYN_FRAME = 3;
+static constexpr int SWP_SYNACK_FRAME = 4;
+static constexpr int SWP_PROBE_FRAME = 5;
+static constexpr int SWP_PROBEACK_FRAME = 6;
+
+// wire format.  Every frame starts with an 8 byte header, with all fields
+// most significant byte first:
+//    byte 0      version (high four bits) and kind of frame (low four bits)
+//    byte 1      flags; the low four bits are the integrity policy,
+//                SWP_FLAG_RESUME marks a handshake that uses a resumption
+//                token, SWP_FLAG_COMPRESS marks a data frame whose
+//                payload is compressed (see lz.h), and SWP_FLAG_RECORDS
+//                one whose payload is a series of records, each a
+//                message's length in SWP_RECORD_HEADER bytes followed by
+//                the message
+//    bytes 2-3   sequence number
+//    bytes 4-5   payload length
+//    bytes 6-7   parity frames: parity index (high byte) and block size
+// This is followed by the check value, CK_size(policy) bytes long, and
+// then the payload.  The check value covers the header and the payload.
+//
+// For a parity frame the sequence number is that of the first frame in its
+// block, the length field holds the parity of the frame lengths, and the
+// payload is as long as the longest frame of the block.  An ack has no
+// payload and acknowledges every frame up to its sequence number.
+//
+// A probe is a frame of a given payload size, all zeros, sent to find out
+// whether datagrams that big get through; the receiver answers it with a
+// probe ack with the same sequence number and length and no payload.
+//
+// A session starts with a handshake.  The sender's SYN carries its initial
+// sequence number (the frame before its first data frame) and the session
+// parameters it proposes; the receiver's SYNACK echoes the sequence number
+// and carries the parameters agreed on and a resumption token.  Both have
+// an SWP_HANDSHAKE_SIZE byte payload:
+//    bytes 0-1   window size
+//    bytes 2-3   payload size
+//    byte 4      integrity policy
+//    byte 5      number of stripes (0, from older peers, means 1)
+//    bytes 6-13  resumption token
+// SWP_FLAG_COMPRESS on a SYN offers to compress data frames, and on the
+// SYNACK agrees to it.  The sender only compresses once it's agreed, or
+// from the start if the session it resumes had agreed to it.
+// SWP_FLAG_RECORDS on a SYN offers to pack small messages into frames of
+// records, and on the SYNACK agrees to take them.
+// Handshake frames are always checked with SWP_HANDSHAKE_CHECK, since the
+// policy for the rest of the session isn't known yet.
+static constexpr int SWP_VERSION = 1;
+static constexpr int SWP_HEADER_SIZE = 8;
+static constexpr int SWP_OFF_VERTYPE = 0;
+static constexpr int SWP_OFF_FLAGS = 1;
+static constexpr int SWP_OFF_SEQNUM = 2;
+static constexpr int SWP_OFF_LENGTH = 4;
+static constexpr int SWP_OFF_AUX = 6;
+static constexpr int SWP_OFF_CHECK = SWP_HEADER_SIZE;
+static constexpr int SWP_MAX_CHECK_SIZE = 8;
+static constexpr int SWP_MAX_FRAME = SWP_HEADER_SIZE + SWP_MAX_CHECK_SIZE +
+  SWP_PAYLOAD_SIZE;
+static constexpr int SWP_IP_UDP_HEADERS = 28;
+static constexpr int SWP_FLAG_CHECK_MASK = 0x0f;
+static constexpr int SWP_FLAG_RESUME = 0x10;
+static constexpr int SWP_FLAG_COMPRESS = 0x20;
+static constexpr int SWP_FLAG_RECORDS = 0x40;
+static constexpr int SWP_RECORD_HEADER = 2;
+static constexpr int SWP_HANDSHAKE_SIZE = 6 + SWP_TOKEN_SIZE;
+static constexpr int SWP_HANDSHAKE_CHECK = CK_CRC32C;
+
+// a frame is only sent compressed if that saves at least this many bytes
+static constexpr int SWP_COMPRESS_MIN_GAIN = 8;
+
+// the sender may send this many data frames before the handshake is
+// answered, unless it is resuming a session, when it may send a whole
+// window
+static constexpr int SWP_INITIAL_FLIGHT = 4;
+
+// a probe that isn't answered after this many tries is taken to be too
+// big for the path
+static constexpr int SWP_PROBE_TRIES = 3;
+
+static_assert (SWP_OFF_AUX + 2 == SWP_HEADER_SIZE,
+	       "header fields must fill the header exactly");
+static_assert (SWP_HEADER_SIZE + SWP_MAX_CHECK_SIZE <= 16,
+	       "header and check value must fit in 16 bytes");
+static_assert (SWP_PAYLOAD_SIZE <= 0xffff,
+	       "payload length must fit in the 16 bit length field");
+static_assert (SWP_MAX_FRAME + SWP_IP_UDP_HEADERS <= 9000,
+	       "frames must fit in a jumbo frame");
+static_assert (SWP_MAX_FRAME <= SHM_MAX_DATAGRAM,
+	       "frames must fit in a shared memory slot");
+static_assert (SWP_MAX_STRIPES <= UR_MAX_SOCKETS,
+	       "a ring must take in every stripe");
+static_assert (SWP_DEFAULT_PAYLOAD <= SWP_PAYLOAD_SIZE,
+	       "the default payload must fit in a frame");
+static_assert (SWP_SEQ_SPACE <= 0x10000 &&
+	       (SWP_SEQ_SPACE & (SWP_SEQ_SPACE - 1)) == 0,
+	       "sequence numbers must fit in the 16 bit sequence field, and "
+	       "wrap with a mask");
+static_assert (WindowPow2 >= 1 && (WindowPow2 & (WindowPow2 - 1)) == 0 &&
+	       WindowPow2 <= SWP_WINDOW_LIMIT,
+	       "the window must be a power of two no bigger than the limit");
+static_assert ((SWP_BUFSIZE & (SWP_BUFSIZE - 1)) == 0 && SWP_BUFSIZE >= 64 &&
+	       SWP_SEQ_SPACE % SWP_BUFSIZE == 0 &&
+	       SWP_BUFSIZE >= 2 * WindowPow2,
+	       "buffer slots must be a power of two and hold two windows");
+
+// a frame header, decoded
+struct SWP_header {
+  int type;
+  int flags;
+  int seqNum;
+  int length;
+  int aux;
+};
+
+// the layout used before the wire format was versioned, when these structs
+// were sent as they are, padding and host byte order included, with crc
+// holding calcCRC of the whole struct in network byte order.  Frames from
+// old peers are still decoded (see SWP_decodeLegacy) and answered with
+// legacy acks.
+static constexpr int SWP_LEGACY_PAYLOAD_SIZE = 1024;
+struct SWP_legacyDataMsg {
+  unsigned char seqNum;
+  int length;
+  unsigned char data[SWP_LEGACY_PAYLOAD_SIZE];
+  unsigned int crc;
+};
+
+struct SWP_legacyAckMsg {
+  unsigned char ackNum;
+  unsigned int crc;
+};
+
+static_assert (sizeof(struct SWP_legacyDataMsg) == 1036,
+	       "legacy data frames are 1036 bytes");
+static_assert (sizeof(struct SWP_legacyAckMsg) == 8,
+	       "legacy acks are 8 bytes");
+
+// a data frame held in memory.  records is true for a frame of records.
+struct SWP_dataMsg {
+  int seqNum;
+  int type;
+  int records;
+  int length;
+  unsigned char data[SWP_PAYLOAD_SIZE];
+};
+
+// define state variables
+
+// status of the module
+int SWP_sendWait;    // true iff sender must wait for buffer space
+int SWP_recvWait;    // true iff receiver must wait for message
+int SWP_sending;     // true once SWP_sendInit has been called
+int SWP_receiving;   // and SWP_recvInit
+int SWP_closing;     // true once SWP_close has been called
+
+// failure.  A sender whose frames go unanswered ends the process, unless
+// SWP_setExitOnFailure says not to; the engine is then marked failed, and
+// whatever waits on the peer stops waiting.
+int SWP_exitOnFailure = 1;
+int SWP_failed;
+
+// socket variables and addresses
+int SWP_sendDataSock, SWP_recvDataSock;
+struct sockaddr_in SWP_sendDataAddr, SWP_recvDataAddr;
+int SWP_sendSockets, SWP_recvSockets;  // sockets opened, for SWP_close
+
+// striping.  A session may be spread over several sockets, each with its
+// own port, so that the NICs spread its packets over several queues and
+// cores.  Stripe 0 is the socket above, served by the SIGIO handlers;
+// every other stripe is served by a thread of its own.  Stripe i of the
+// sender sends to port+i of the receiver, and the receiver answers on the
+// stripe a frame came in on.  Data frames are spread over the stripes by
+// slot; handshakes, probes and parity frames use stripe 0.  A process that
+// both sends and receives has a set of stripes for each.
+//
+// Protocol state is guarded by SWP_mutex as well as by blocking SIGIO and
+// SIGALRM.  The stripe threads block every signal.  Any other thread holds
+// the mutex only with those signals blocked (see SWP_lock), so a handler
+// never waits for the mutex held by the thread it interrupted.
+int SWP_numStripes = 1;    // stripes we set up
+int SWP_stripesInUse = 1;  // stripes agreed for the session
+int SWP_stripeSock [SWP_MAX_STRIPES];
+struct sockaddr_in SWP_stripeAddr [SWP_MAX_STRIPES];
+int SWP_recvStripeSock [SWP_MAX_STRIPES];
+pthread_mutex_t SWP_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// shared memory (see shm.h).  A receiver offers senders on its own host a
+// channel named after its port, and a sender that finds one puts all its
+// frames there instead of on its sockets, and takes the answers from it.
+// The frames and the protocol are the same either way.  Each end takes
+// what comes in on the channel in a thread of its own, which blocks every
+// signal like the stripe threads.  The receiver handles frames from the
+// channel as if they had come in on socket SWP_SHM_SOCK, so that they're
+// answered the same way they came.  SWP_setSharedMemory turns this off.
+static constexpr const char *SWP_SHM_NAME = "/swp-%u";
+static constexpr int SWP_SHM_SOCK = -2;
+struct SHM_channel *SWP_sendShm;  // null if we send on sockets
+struct SHM_channel *SWP_recvShm;  // null if we offer no channel
+int SWP_localShm = 1;  // true iff we'd use shared memory
+
+// io_uring (see uring.h).  With SWP_BACKEND_URING, each end that can have
+// a ring serves its stripes through it instead of SIGIO and the stripe
+// threads.  A thread of its own, which blocks every signal like the
+// stripe threads, takes what comes in on all the stripes.  Frames and
+// answers are queued on the ring as they're sent, and go to the kernel
+// together whenever the lock is let go (see SWP_ringSubmit), so that a
+// batch of acks, or a window resent by the timer, costs one system call.
+// The SIGIO handlers leave sockets served by a ring alone; SIGIO then only
+// wakes threads in SWP_wait.  A probe too big for our own interface isn't
+// refused at once through a ring, so it times out like one too big for the
+// path.
+int SWP_backend = IoBackend::backend;
+struct UR_ring *SWP_sendRing;   // null if the sender uses sockets
+struct UR_ring *SWP_recvRing;   // and the receiver
+
+// threads in SWP_wait, which SWP_wake sends SIGIO.  If more threads than
+// this wait at once the rest poll.
+static constexpr int SWP_MAX_WAITERS = 16;
+pthread_t SWP_waiter [SWP_MAX_WAITERS];
+int SWP_numWaiters;
+
+// the threads we've started, so that SWP_close can wait for them.  Each
+// runs serve on its engine, passing it arg.
+static constexpr int SWP_MAX_THREADS = 2 * SWP_MAX_STRIPES + 4;
+struct SWP_thread {
+  Swp *engine;
+  void *(Swp::*serve) (void *);
+  long arg;
+  pthread_t thread;
+};
+struct SWP_thread SWP_threads [SWP_MAX_THREADS];
+int SWP_numThreads;
+
+// the send queue.  Once SWP_setSendQueue has been called SWP_send and
+// SWP_sendNoCopy may be called from any number of threads at once.  They
+// put the message on a bounded lock-free queue, and SWP_sendEngine, a
+// thread of ours, takes the messages off in order and sends them as
+// SWP_send would have.  Messages from one thread therefore go in the order
+// they were queued.
+//
+// The queue is an array of SWP_queueSize cells, a power of two.  Each
+// cell's sequence number says whose turn it is: when it equals the
+// position of the cell it is free for the producer that claims that
+// position, and when it is one more it holds a message for the engine.
+// Producers claim positions with a compare and swap on SWP_queueIn; only
+// the engine moves SWP_queueOut.  The semaphores count full and free
+// cells, so that the engine sleeps while the queue is empty and producers
+// while it is full.
+//
+// Each cell has SWP_QUEUE_DATA bytes of its own, allocated with the queue,
+// that a message is copied into once its cell is claimed; only a message
+// bigger than that is copied into memory allocated for it.  The engine
+// gives a cell back once it has sent from it.
+static constexpr int SWP_QUEUE_DATA = SWP_PAYLOAD_SIZE;
+struct SWP_queueCell {
+  std::atomic_size_t seq;
+  const char *buf;     // the message: data, unless it wasn't copied
+  int length;
+  int copy;
+  long long enqueued;  // when it was queued, if tracing
+  char *spill;         // the copy of a message too big for data, or null
+  char *data;          // SWP_QUEUE_DATA bytes
+};
+int SWP_queueSize;             // 0 unless the queue is used
+struct SWP_queueCell *SWP_queue;
+char *SWP_queueData;           // the cells' data, end to end
+std::atomic_size_t SWP_queueIn;     // next position to fill
+size_t SWP_queueOut;           // next position to empty
+sem_t SWP_queueFull, SWP_queueFree;
+std::atomic_llong SWP_queueSubmitted; // messages queued so far
+long long SWP_queueSent;       // and sent, guarded by the lock
+
+// tracing (see SWP_setTrace).  Where the kernel can, it stamps frames as
+// they come in and, at the sender, as they leave; the stamps of frames
+// sent come back on the sockets' error queues along with the frames.
+int SWP_tracing;
+int SWP_traceSent;   // true iff frames sent are stamped
+
+// compression.  The sender compresses each data frame's payload once the
+// session agrees to it, and sends it as it is if it doesn't shrink; the
+// receiver decompresses into the receive buffer.
+int SWP_localCompress;       // true iff we'd compress
+int SWP_compressing;         // true iff the session compresses
+long long SWP_compressNsecs, SWP_decompressNsecs;
+
+// coalescing (see SWP_setCoalescing).  Once the session agrees to it,
+// small messages are packed into SWP_coalesceBuf as records, and the frame
+// goes out when the next message won't fit or when SWP_coalesceDeadline
+// passes, which SWP_coalesceTimer waits for.  SWP_coalesceMutex guards the
+// buffer; it is taken before the lock, never while holding it.  The
+// receiver hands a frame of records over a record at a time, and
+// SWP_recordOffset is how far it has got through the frame at the front
+// of Q.
+//
+// A frame of records is copied out of the buffer to be sent, so that
+// messages can be packed into the next one while it waits for room in the
+// window.  Frames still go in the order they were filled: whoever sends a
+// frame of records, or a message that isn't packed, first takes a ticket
+// under SWP_coalesceMutex, and waits for SWP_sendServing to reach it.
+int SWP_coalesceUsecs;          // the deadline, 0 if off
+int SWP_coalescing;             // true iff the session coalesces
+unsigned char SWP_coalesceBuf [SWP_PAYLOAD_SIZE];
+int SWP_coalesceLength;         // bytes in the buffer
+int SWP_coalesceCount;          // and messages
+long long SWP_coalesceEnqueued; // when the first was handed to us
+struct timespec SWP_coalesceDeadline;
+pthread_mutex_t SWP_coalesceMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t SWP_coalesceStarted;
+unsigned long SWP_sendTicket;   // tickets handed out
+unsigned long SWP_sendServing;  // the ticket whose turn it is
+pthread_cond_t SWP_sendTurn = PTHREAD_COND_INITIALIZER;
+int SWP_recordOffset;
+
+// sliding window bounds
+// window sizes, and the size of the receiving sequence space, which is
+// SWP_SEQ_SPACE except for a session with a legacy sender, whose space is
+// twice its window.  SWP_ReceiveMask is one less than the size when that
+// is a power of two, as it always is but for some legacy windows, and 0
+// otherwise; SWP_recvSeq wraps a sequence number with whichever applies.
+// The sending sequence space is always SWP_SEQ_SPACE.
+int SWP_SWS;
+int SWP_RWS;
+int SWP_ReceiveSize;
+int SWP_ReceiveMask;
+int SWP_recvSeq (int seq)
+{
+  return SWP_ReceiveMask ? seq & SWP_ReceiveMask : seq % SWP_ReceiveSize;
+}
+int SWP_maxWindow;   // largest window we'll agree to
+
+int SWP_LAR;    // Last Acknowledgement Received
+int SWP_LFS;    // Last Frame Sent
+int SWP_LFR;    // Last Frame Received
+int SWP_LAF;    // Last Acceptable Frame
+int SWP_sendSlotsAvail;  // number of available slots in send window
+int SWP_lastFrameConsumed; // last frame sent to application
+
+// buffers for sending and receiving data and acks.  Frames waiting to be
+// acked are kept encoded, ready to be resent.
+unsigned char SWP_sendBuffer [SWP_BUFSIZE][SWP_MAX_FRAME];
+int SWP_sendLength [SWP_BUFSIZE];
+
+// a frame given to SWP_sendNoCopy keeps only its header and check value in
+// SWP_sendBuffer; its payload is sent from the caller's buffer, here.
+// SWP_sendLength still counts the whole frame.
+const unsigned char *SWP_sendData [SWP_BUFSIZE];
+int SWP_sendDataLen [SWP_BUFSIZE];
+struct SWP_dataMsg SWP_receiveBuffer [SWP_BUFSIZE];
+
+// the reorder buffer: bit SWP_slot(seq) is set iff frame seq is waiting in
+// SWP_receiveBuffer to be delivered.  Runs of frames are found, delivered
+// and cleared a word at a time.
+static constexpr int SWP_FRAME_WORDS = SWP_BUFSIZE / 64;
+uint64_t SWP_frameBits [SWP_FRAME_WORDS];
+int SWP_haveFrame (int slot)
+{
+  return (SWP_frameBits[slot >> 6] >> (slot & 63)) & 1;
+}
+void SWP_markFrame (int slot)
+{
+  SWP_frameBits[slot >> 6] |= 1ULL << (slot & 63);
+}
+
+// buffers for received data not consumed yet.  Q_DATASIZE is a power of
+// two, so the ends wrap with a mask.
+static constexpr int Q_DATASIZE = 1024;
+struct QStruct {
+  struct SWP_dataMsg data [Q_DATASIZE];
+  int front;
+  int rear;
+  int size;
+};
+struct QStruct Q;
+static_assert ((Q_DATASIZE & (Q_DATASIZE - 1)) == 0,
+	       "Q must wrap with a mask");
+
+// forward error correction.  The sender follows every block of SWP_fecK
+// frames with SWP_fecM parity frames, accumulated in SWP_fecParity as the
+// frames are sent.  Each parity vector is the two length bytes of the
+// frame, least significant first and with SWP_FEC_RECORDS set for a frame
+// of records, followed by its data, zero padded.
+static constexpr int SWP_FEC_VECSIZE = SWP_PAYLOAD_SIZE + 2;
+static constexpr int SWP_FEC_RECORDS = 0x8000;
+int SWP_fecK, SWP_fecM;      // block size and redundancy, 0 if off
+int SWP_fecBlockStart;       // seqNum of first frame in the block
+int SWP_fecBlockCount;       // frames in the block so far
+int SWP_fecBlockMax;         // longest frame in the block so far
+unsigned char SWP_fecParity [FEC_MAX_PARITY][SWP_FEC_VECSIZE];
+
+// the receiver keeps the parity frames of each block, indexed by the
+// sequence number of the block's first frame, until the block's last
+// frame has been delivered.  Only what recovery needs of a parity frame is
+// kept, and only fecSize bytes of its data are copied.  The buffer is big,
+// so it's only allocated once a parity frame comes in.
+struct SWP_parityMsg {
+  int fecCount;                     // frames in the block
+  int fecSize;                      // bytes of parity data
+  int length;                       // the parity of the length bytes
+  unsigned char data[SWP_PAYLOAD_SIZE];
+};
+struct SWP_parityMsg (*SWP_parityBuffer)[FEC_MAX_PARITY];
+int SWP_parityReceived [SWP_BUFSIZE];  // bit j set iff parity j held
+int SWP_fecBlockOf [SWP_BUFSIZE];      // block a frame is in, or -1
+unsigned char SWP_fecSyndrome [FEC_MAX_PARITY][SWP_FEC_VECSIZE];
+
+// pacing.  Transmissions are spread out by a token bucket that holds up
+// to SWP_paceBurst frames' worth of bytes and fills at SWP_paceRate bytes
+// per second or, if that is 0, at one window per smoothed round trip time.
+// A frame's worth is the most a frame of the current payload size takes.
+int SWP_frameSize (void)
+{
+  return SWP_HEADER_SIZE + SWP_MAX_CHECK_SIZE + SWP_payloadSize;
+}
+int SWP_paceBurst;            // bucket depth in frames, 0 if off
+long SWP_paceRate;            // bytes per second, 0 to follow rtt
+double SWP_paceTokens;        // bytes that may be sent now
+struct timespec SWP_paceLast; // time the bucket was last filled
+
+// smoothed round trip time in seconds, 0 until the first sample, and the
+// time each frame was sent
+double SWP_srtt;
+struct timespec SWP_sendTime [SWP_BUFSIZE];
+
+// payload size.  SWP_localPayload is the largest we'll agree to in a
+// handshake, and SWP_payloadSize the largest the sender uses now, which
+// path MTU probing raises from SWP_DEFAULT_PAYLOAD to the agreed size as
+// bigger frames are found to get through.  SWP_recvPayloadSize is the
+// largest the receiver's session may send.  SWP_probeLo is the largest
+// payload known to get through and SWP_probeHi the largest that might;
+// SWP_probeSize is the payload of the probe awaiting an answer, if any.
+int SWP_localPayload = SWP_DEFAULT_PAYLOAD;
+int SWP_payloadSize;
+int SWP_recvPayloadSize;
+int SWP_probing;
+int SWP_probeLo, SWP_probeHi;
+int SWP_probeSize;
+int SWP_probeSeq;
+int SWP_probeTries;
+struct timeval SWP_probeTimeout;
+unsigned char SWP_probePad [SWP_PAYLOAD_SIZE];
+
+// integrity policy of the sender's session, used for the frames it sends
+// and required of the acks it receives, and the policy we ask for in a
+// handshake.  SWP_recvPolicy is the receiver's, for the frames it takes
+// and the acks it sends; the receiver also takes frames under
+// SWP_recvAltPolicy, the policy its peer proposed, since the first flight
+// of data was sent under that.
+int SWP_checkPolicy = ChecksumPolicy::policy;
+int SWP_localPolicy = ChecksumPolicy::policy;
+int SWP_altPolicy = -1;
+int SWP_recvPolicy = ChecksumPolicy::policy;
+int SWP_recvAltPolicy = -1;
+
+// session state.  The sender's handshake is resent like a data frame
+// until it is answered; the receiver has no session until a handshake (or
+// a legacy frame) arrives.  SWP_session holds the parameters agreed on
+// and the token the receiver gave us, and SWP_recvSession those the
+// receiver agreed to and the address of the sender it agreed with.
+int SWP_sessionOpen;
+int SWP_sessionISN;
+int SWP_resumed;
+int SWP_resuming;
+struct SWP_resumeToken SWP_session;
+int SWP_recvSessionOpen;
+int SWP_recvSessionISN;
+int SWP_sessionLegacy;
+int SWP_recvResumed;
+struct SWP_resumeToken SWP_recvSession;
+struct sockaddr_in SWP_recvPeer;
+struct timespec SWP_recvHeard;
+unsigned char SWP_synFrame [SWP_HEADER_SIZE + SWP_MAX_CHECK_SIZE +
+		     SWP_HANDSHAKE_SIZE];
+int SWP_synLength;
+int SWP_synTimeouts;
+struct timeval SWP_synTimeout;
+
+// the receiver's key for resumption tokens; tokens issued by an earlier
+// receiver process aren't valid
+unsigned long long SWP_tokenKey;
+
+// statistics
+struct SWP_stats SWP_stats;
+
+// number of timeouts for each message
+int SWP_numTimeouts [SWP_BUFSIZE];
+
+// indicates if a timeout is set, and if so, when it expires
+int SWP_sendTimeoutSet [SWP_BUFSIZE];
+struct timeval SWP_sendTimeout [SWP_BUFSIZE];
+
+public:
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_sendInit
+//
+///////////////////////////////////////////////////////////////////////////////
+int SWP_sendInit (char *hostname,short portNum,int winSize)
+{
+  struct hostent *hp;
+  struct sigaction handler1;
+  struct sigaction handler2;
+  sigset_t oldsigset;
+  struct itimerval timeVal;
+  struct timespec now;
+  struct SWP_header header;
+  unsigned char params [SWP_HANDSHAKE_SIZE];
+  pthread_condattr_t attr;
+  struct sockaddr_in local;
+  socklen_t localSize;
+  char name [32];
+
+  int i,size;
+
+  // set window and sequence sizes
+  if (winSize<1 || winSize>WindowPow2)
+    {
+      printf ("Send window size out of range\n");
+      return -1;
+    }
+  SWP_SWS = winSize;
+
+  // a resumed session uses the parameters agreed on last time, while a
+  // new one proposes our own
+  if (SWP_resuming)
+    {
+      if (SWP_SWS > SWP_session.windowSize)
+	SWP_SWS = SWP_session.windowSize;
+      SWP_checkPolicy = SWP_session.checkPolicy;
+    }
+  else
+    {
+      SWP_session.windowSize = SWP_SWS;
+      SWP_session.payloadSize = SWP_localPayload;
+      SWP_session.checkPolicy = SWP_checkPolicy = SWP_localPolicy;
+      SWP_session.stripes = SWP_numStripes;
+      SWP_session.compress = SWP_localCompress;
+      memset (SWP_session.token,0,SWP_TOKEN_SIZE);
+    }
+
+  // a resumed session compresses from the start if it did before.  Small
+  // messages aren't packed together until the receiver agrees.
+  SWP_compressing = SWP_resuming && SWP_session.compress;
+  SWP_coalescing = 0;
+
+  // a block can't be bigger than the window, or the receiver couldn't tell
+  // which frames it covers
+  if (SWP_fecK > SWP_SWS)
+    SWP_fecK = SWP_SWS;
+  SWP_fecBlockCount = 0;
+
+  // translate hostname into host's IP address
+  hp = gethostbyname(hostname);
+  if (!hp){
+    perror ("sendInit: gethostbyname");
+    return -1;
+  }
+
+  // build address data structures
+  memset (&SWP_sendDataAddr, 0, sizeof(SWP_sendDataAddr));
+  SWP_sendDataAddr.sin_family = AF_INET;
+  memmove (&SWP_sendDataAddr.sin_addr, hp->h_addr_list[0], hp->h_length);
+  SWP_sendDataAddr.sin_port = htons(portNum);
+
+  // create send socket, and one for each other stripe, sending to the
+  // ports after portNum
+  if((SWP_sendDataSock = socket(PF_INET,SOCK_DGRAM,IPPROTO_UDP)) < 0){
+    printf ("sendInit: socket error\n");
+    return -1;
+  }
+  SWP_stripeSock[0] = SWP_sendDataSock;
+  SWP_stripeAddr[0] = SWP_sendDataAddr;
+  SWP_sendSockets = 1;
+  for (i=1;i<SWP_numStripes;i++)
+    {
+      if((SWP_stripeSock[i] = socket(PF_INET,SOCK_DGRAM,IPPROTO_UDP)) < 0){
+	printf ("sendInit: socket error\n");
+	return -1;
+      }
+      SWP_sendSockets++;
+      SWP_stripeAddr[i] = SWP_sendDataAddr;
+      SWP_stripeAddr[i].sin_port = htons(portNum + i);
+    }
+
+  // as in SWP_recvInit, make room for a couple of windows of frames
+  size = 2 * winSize * (SWP_HEADER_SIZE + SWP_MAX_CHECK_SIZE +
+			SWP_localPayload);
+  for (i=0;i<SWP_numStripes;i++)
+    setsockopt (SWP_stripeSock[i],SOL_SOCKET,SO_SNDBUF,&size,sizeof(size));
+
+  // have the kernel stamp frames as they leave and acks as they come in
+  if (SWP_tracing)
+    for (i=0;i<SWP_numStripes;i++)
+      SWP_traceSocket (SWP_stripeSock[i],1);
+
+  // a receiver on this host may take our frames through shared memory.
+  // It's told the address our socket would have sent them from.
+  SWP_sendShm = 0;
+  if (SWP_localShm && SWP_isLocal (&SWP_sendDataAddr))
+    {
+      memset (&local,0,sizeof(local));
+      local.sin_family = AF_INET;
+      localSize = sizeof(local);
+      if (bind (SWP_sendDataSock,(struct sockaddr *)&local,sizeof(local)) == 0
+	  && getsockname (SWP_sendDataSock,(struct sockaddr *)&local,
+			  &localSize) == 0)
+	{
+	  local.sin_addr = SWP_sendDataAddr.sin_addr;
+	  snprintf (name,sizeof(name),SWP_SHM_NAME,(unsigned short)portNum);
+	  SWP_sendShm = SHM_attach (name,&local);
+	}
+    }
+
+  // otherwise the stripes may be served through a ring.  Tracing needs
+  // the kernel's stamps, which only the sockets give.
+  SWP_sendRing = 0;
+  if (SWP_ringWanted() && !SWP_sendShm && !SWP_tracing)
+    SWP_sendRing = UR_open (SWP_HEADER_SIZE + SWP_MAX_CHECK_SIZE +
+			    SWP_HANDSHAKE_SIZE,SWP_MAX_FRAME);
+
+  // set up SIGIO handler for received acks
+  handler1.sa_handler = SWP_allSIGIO;
+  if (sigfillset (&handler1.sa_mask) < 0){
+    printf ("sendInit: segfillset1 error\n");
+    return -1;
+  }
+  handler1.sa_flags = 0;
+  if (sigaction(SIGIO, &handler1, 0) < 0){
+    printf ("sendInit: sigaction1 error\n");
+    return -1;
+  }
+
+  if (!SWP_sendRing && fcntl(SWP_sendDataSock, F_SETOWN, getpid()) < 0){
+    perror("sendInit:fcntl1 ");
+    return -1;
+  }
+  if (!SWP_sendRing &&
+      fcntl(SWP_sendDataSock, F_SETFL, O_NONBLOCK|FASYNC) < 0){
+    printf ("sendInit: fcntl2 error\n");
+    return -1;
+  }
+
+  // no send timeouts yet
+  for (i=0;i<SWP_BUFSIZE;i++)
+    SWP_sendTimeoutSet[i] = 0;
+
+  // initialize sending window from a random initial sequence number.
+  // Until the handshake is answered only a first flight of frames may be
+  // sent, unless we're resuming a session.
+  clock_gettime (CLOCK_REALTIME,&now);
+  SWP_sessionISN = SWP_seq (now.tv_nsec ^ getpid());
+  SWP_LAR = SWP_LFS = SWP_sessionISN;
+  SWP_stripesInUse = 1;
+  SWP_sendSlotsAvail = SWP_SWS;
+  if (!SWP_resuming && SWP_sendSlotsAvail > SWP_INITIAL_FLIGHT)
+    SWP_sendSlotsAvail = SWP_INITIAL_FLIGHT;
+
+  // when probing, frames stay small until bigger ones are known to get
+  // through.  The probes must not be fragmented, so set don't fragment
+  // and ignore what the kernel thinks the path MTU is.
+  SWP_payloadSize = SWP_session.payloadSize;
+  if (SWP_payloadSize > SWP_localPayload)
+    SWP_payloadSize = SWP_localPayload;
+  if (SWP_probing)
+    {
+      SWP_probeHi = SWP_payloadSize;
+      if (SWP_payloadSize > SWP_DEFAULT_PAYLOAD)
+	SWP_payloadSize = SWP_DEFAULT_PAYLOAD;
+      SWP_probeLo = SWP_payloadSize;
+      SWP_probeSize = 0;
+#ifdef IP_PMTUDISC_PROBE
+      size = IP_PMTUDISC_PROBE;
+      for (i=0;i<SWP_numStripes;i++)
+	if (setsockopt (SWP_stripeSock[i],IPPROTO_IP,IP_MTU_DISCOVER,
+			&size,sizeof(size)) < 0){
+	  perror ("sendInit: setsockopt");
+	  return -1;
+	}
+#endif
+    }
+
+  // no round trip time yet, and the bucket starts out full
+  SWP_srtt = 0;
+  clock_gettime (CLOCK_MONOTONIC,&SWP_paceLast);
+  SWP_paceTokens = SWP_paceBurst * SWP_frameSize ();
+
+  // we're not waiting for buffer space to become available
+  SWP_sendWait = 0;
+
+  // send the handshake.  Data may follow it straight away.
+  header.type = SWP_SYN_FRAME;
+  header.flags = (SWP_resuming ? SWP_FLAG_RESUME : 0) |
+    (SWP_session.compress ? SWP_FLAG_COMPRESS : 0) |
+    (SWP_coalesceUsecs ? SWP_FLAG_RECORDS : 0);
+  header.seqNum = SWP_sessionISN;
+  header.length = SWP_HANDSHAKE_SIZE;
+  header.aux = 0;
+  SWP_putParams (params,&SWP_session);
+  SWP_synLength =
+    SWP_encodeFrame (SWP_synFrame,&header,params,SWP_HANDSHAKE_SIZE);
+  SWP_sessionOpen = 0;
+  SWP_synTimeouts = 0;
+
+  // the handlers may look at the sender from here on, from any thread, so
+  // the handshake goes out under the lock
+  if (SWP_register () < 0)
+    return -1;
+  SWP_lock (&oldsigset);
+  SWP_sending = 1;
+  SWP_sendSyn ();
+  SWP_unlock (&oldsigset);
+
+  // set up timer handler so it ticks every tenth of a second
+  if (sigfillset (&handler2.sa_mask) < 0){
+    printf ("sendInit: segfillset2 error\n");
+    return -1;
+  }
+
+  handler2.sa_handler = SWP_allTimers;
+  handler2.sa_flags = 0;
+  if (sigaction(SIGALRM, &handler2, 0) < 0){
+    printf ("sendInit: sigaction3 error\n");
+    return -1;
+  }
+
+  timeVal.it_interval.tv_sec = 0;
+  timeVal.it_interval.tv_usec = 100000;
+  timeVal.it_value.tv_sec = 0;
+  timeVal.it_value.tv_usec = 100000;
+  if (setitimer (ITIMER_REAL,&timeVal,0) < 0) {
+    perror ("SWP_sendInit: setitimer error");
+    return -1;
+  }
+
+  // messages on the send queue are sent by a thread of their own
+  if (SWP_queueSize)
+    {
+      SWP_queue = (struct SWP_queueCell *)
+	malloc (SWP_queueSize * sizeof(*SWP_queue));
+      SWP_queueData = (char *)malloc ((size_t)SWP_queueSize * SWP_QUEUE_DATA);
+      if (!SWP_queue || !SWP_queueData)
+	{
+	  printf ("sendInit: out of memory\n");
+	  return -1;
+	}
+      for (i=0;i<SWP_queueSize;i++)
+	{
+	  std::atomic_init (&SWP_queue[i].seq,i);
+	  SWP_queue[i].data = SWP_queueData + (size_t)i * SWP_QUEUE_DATA;
+	}
+      std::atomic_init (&SWP_queueIn,0);
+      SWP_queueOut = 0;
+      sem_init (&SWP_queueFull,0,0);
+      sem_init (&SWP_queueFree,0,SWP_queueSize);
+      if (SWP_startThread (&Swp::SWP_sendEngine,"the send queue") < 0)
+	return -1;
+    }
+
+  // frames of records that aren't filled in time are sent by a thread of
+  // their own
+  if (SWP_coalesceUsecs)
+    {
+      pthread_condattr_init (&attr);
+      pthread_condattr_setclock (&attr,CLOCK_MONOTONIC);
+      pthread_cond_init (&SWP_coalesceStarted,&attr);
+      if (SWP_startThread (&Swp::SWP_coalesceTimer,"coalescing") < 0)
+	return -1;
+    }
+
+  // answers that come through shared memory are taken by a thread of their
+  // own
+  if (SWP_sendShm && SWP_startThread (&Swp::SWP_ackShm,"shared memory") < 0)
+    return -1;
+
+  // a ring takes the acks on every stripe in one thread; without one, acks
+  // on the other stripes are taken by their own threads
+  if (SWP_sendRing)
+    return SWP_startThread (&Swp::SWP_ackUring,"the ring");
+  return SWP_startStripes (&Swp::SWP_ackStripe);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_send
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_send (char *buf, int length)
+{
+  if (SWP_queueSize)
+    SWP_submit (buf,length,1);
+  else
+    SWP_sendPieces (buf,length,1,SWP_tracing ? TR_now() : 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_sendNoCopy
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_sendNoCopy (const char *buf, int length)
+{
+  if (SWP_queueSize)
+    SWP_submit (buf,length,0);
+  else
+    SWP_sendPieces (buf,length,0,SWP_tracing ? TR_now() : 0);
+}
+
+private:
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_submit
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_submit (const char *buf, int length, int copy)
+{
+  // put a message on the send queue for SWP_sendEngine.  Called from any
+  // thread, without the lock.
+  struct SWP_queueCell *cell;
+  long long enqueued;
+  size_t pos;
+
+  enqueued = SWP_tracing ? TR_now() : 0;
+
+  // wait for a free cell, then claim the next position.  Another producer
+  // may claim it first, in which case we try the one after.
+  while (sem_wait (&SWP_queueFree) < 0)
+    ;
+  std::atomic_fetch_add (&SWP_queueSubmitted,1);
+  pos = std::atomic_load_explicit (&SWP_queueIn,std::memory_order_relaxed);
+  while (1)
+    {
+      cell = &SWP_queue[pos & (SWP_queueSize - 1)];
+      if (std::atomic_load_explicit (&cell->seq,std::memory_order_acquire) == pos &&
+	  std::atomic_compare_exchange_weak_explicit (&SWP_queueIn,&pos,pos + 1,
+						 std::memory_order_relaxed,
+						 std::memory_order_relaxed))
+	break;
+      pos = std::atomic_load_explicit (&SWP_queueIn,std::memory_order_relaxed);
+    }
+
+  // fill the cell and hand it to the engine
+  cell->length = length;
+  cell->copy = copy;
+  cell->enqueued = enqueued;
+  cell->spill = 0;
+  cell->buf = buf;
+  if (copy && length <= SWP_QUEUE_DATA)
+    cell->buf = (const char *)memcpy (cell->data,buf,length);
+  else if (copy)
+    {
+      if (!(cell->spill = (char *)malloc (length)))
+	{
+	  printf ("SWP_send: out of memory\n");
+	  exit (1);
+	}
+      cell->buf = (const char *)memcpy (cell->spill,buf,length);
+    }
+  std::atomic_store_explicit (&cell->seq,pos + 1,std::memory_order_release);
+  sem_post (&SWP_queueFull);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_sendEngine
+//
+///////////////////////////////////////////////////////////////////////////////
+void *SWP_sendEngine (void *arg)
+{
+  // the thread that takes messages off the send queue and sends them
+  struct SWP_queueCell *cell;
+  sigset_t oldsigset;
+
+  while (1)
+    {
+      while (sem_wait (&SWP_queueFull) < 0)
+	;
+      if (SWP_closing)
+	break;
+
+      // a message has been queued, but the producer that claimed the cell
+      // before it may not have filled its cell yet
+      cell = &SWP_queue[SWP_queueOut & (SWP_queueSize - 1)];
+      while (std::atomic_load_explicit (&cell->seq,std::memory_order_acquire) !=
+	     SWP_queueOut + 1)
+	sched_yield ();
+      SWP_sendPieces (cell->buf,cell->length,cell->copy,cell->enqueued);
+      free (cell->spill);
+
+      // the cell's data has been copied out, so it may be used again
+      std::atomic_store_explicit (&cell->seq,SWP_queueOut + SWP_queueSize,
+			     std::memory_order_release);
+      SWP_queueOut++;
+      sem_post (&SWP_queueFree);
+
+      // SWP_flush may be waiting for this message to go
+      SWP_lock (&oldsigset);
+      SWP_queueSent++;
+      SWP_wake ();
+      SWP_unlock (&oldsigset);
+    }
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_sendPieces
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_sendPieces (const char *buf, int length, int copy,
+		     long long enqueued)
+{
+  int size;
+
+  // a small message is packed in with those before it if the session
+  // agrees; any other goes after the ones packed so far
+  if (SWP_coalesceUsecs)
+    {
+      pthread_mutex_lock (&SWP_coalesceMutex);
+      if (SWP_coalescing && copy &&
+	  length + SWP_RECORD_HEADER <= SWP_payloadSize)
+	{
+	  SWP_coalesce (buf,length,enqueued);
+	  pthread_mutex_unlock (&SWP_coalesceMutex);
+	  return;
+	}
+      SWP_coalesceSend ();
+      SWP_coalesceTurn (SWP_sendTicket++);
+    }
+
+  // send the message a frame at a time.  The payload size may grow as we
+  // go, if the path is being probed.  enqueued is when the message was
+  // handed to us, for the trace.
+  do
+    {
+      size = length < SWP_payloadSize ? length : SWP_payloadSize;
+      SWP_sendFrame (buf,size,copy,enqueued,0);
+      buf += size;
+      length -= size;
+    }
+  while (length > 0);
+
+  if (SWP_coalesceUsecs)
+    {
+      SWP_coalesceDone ();
+      pthread_mutex_unlock (&SWP_coalesceMutex);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_sendFrame
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_sendFrame (const char *buf, int length, int copy,
+		    long long enqueued, int records)
+{
+  // send a frame of length bytes from buf, a series of records if records,
+  // the number of them, isn't 0
+  sigset_t oldsigset;
+  struct SWP_header header;
+  unsigned char packed [SWP_PAYLOAD_SIZE];
+  struct timespec start,stop;
+  int slot,packedLength;
+
+  // compress the payload if the session does, before taking the lock.  A
+  // frame that doesn't shrink goes as it is.
+  packedLength = -1;
+  if (SWP_compressing)
+    {
+      clock_gettime (CLOCK_MONOTONIC,&start);
+      packedLength = LZ_compress ((const unsigned char *)buf,length,packed,
+				  length - SWP_COMPRESS_MIN_GAIN);
+      clock_gettime (CLOCK_MONOTONIC,&stop);
+    }
+
+  // take the lock, so that we can't get a signal or an ack on another
+  // stripe between the sendto and setting the timers
+  SWP_lock (&oldsigset);
+
+  if (SWP_compressing)
+    {
+      SWP_compressNsecs += SWP_elapsed (&start,&stop) * 1000000000;
+      if (packedLength < 0)
+	SWP_stats.framesNotCompressed++;
+      else
+	{
+	  SWP_stats.framesCompressed++;
+	  SWP_stats.bytesBeforeCompression += length;
+	  SWP_stats.bytesAfterCompression += packedLength;
+	}
+    }
+
+  // wait until it's OK to proceed (i.e., we're not waiting for an ACK),
+  // and for our turn if transmissions are paced.  Either wait lets go of
+  // the lock, and another thread may take the last slot in the window
+  // meanwhile, so the window is looked at again after every wait.  A
+  // frame for a peer we've given up on is dropped.
+  while (1)
+    {
+      if (SWP_failed)
+	{
+	  SWP_unlock (&oldsigset);
+	  return;
+	}
+      if (SWP_sendWait)
+	SWP_wait (&oldsigset);
+      else if (!SWP_paceBurst ||
+	       SWP_paceWait (SWP_HEADER_SIZE + SWP_MAX_CHECK_SIZE +
+			     (packedLength < 0 ? length : packedLength),
+			     &oldsigset))
+	break;
+    }
+
+  // increment LFS, which will be the seqnum for this message
+  SWP_LFS = SWP_seq (SWP_LFS + 1);
+  slot = SWP_slot (SWP_LFS);
+
+  // encode the message into the send buffer, copying in the data unless
+  // the caller promised to leave it alone, and calculating the check value.
+  // A compressed payload is always copied.
+  header.type = SWP_DATA_FRAME;
+  header.flags = records ? SWP_FLAG_RECORDS : 0;
+  header.seqNum = SWP_LFS;
+  header.length = length;
+  header.aux = 0;
+  if (packedLength >= 0)
+    {
+      header.flags |= SWP_FLAG_COMPRESS;
+      header.length = packedLength;
+      SWP_sendData[slot] = 0;
+      SWP_sendLength[slot] =
+	SWP_encodeFrame (SWP_sendBuffer[slot],&header,packed,packedLength);
+    }
+  else if (copy)
+    {
+      SWP_sendData[slot] = 0;
+      SWP_sendLength[slot] =
+	SWP_encodeFrame (SWP_sendBuffer[slot],&header,buf,length);
+    }
+  else
+    {
+      SWP_sendData[slot] = (const unsigned char *)buf;
+      SWP_sendDataLen[slot] = length;
+      SWP_sendLength[slot] = length +
+	SWP_encodeHeader (SWP_sendBuffer[slot],&header,buf,length);
+    }
+
+  // send the message
+  if (SWP_tracing)
+    {
+      TR_record (TR_ENQUEUE,SWP_LFS,0,length,enqueued,0);
+      TR_record (TR_TRANSMIT,SWP_LFS,slot % SWP_stripesInUse,length,0,0);
+    }
+  SWP_transmit (slot);
+  SWP_stats.framesSent++;
+  if (records)
+    {
+      SWP_stats.framesCoalesced++;
+      SWP_stats.messagesCoalesced += records;
+    }
+  clock_gettime (CLOCK_MONOTONIC,&SWP_sendTime[slot]);
+
+  // add it to the parity of its block, which goes out once the block is
+  // complete
+  if (SWP_fecK)
+    SWP_fecAdd (SWP_LFS,(const unsigned char *)buf,length,records != 0);
+
+  // set timeout
+  SWP_setSendTimeout (SWP_LFS);
+
+  // no timeouts yet for this message
+  SWP_numTimeouts[slot] = 0;
+
+  // alter status
+  SWP_sendSlotsAvail--;
+  SWP_sendWait = (SWP_sendSlotsAvail <= 0);
+
+  SWP_unlock (&oldsigset);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_coalesce
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_coalesce (const char *buf, int length, long long enqueued)
+{
+  // add a message of length bytes, which fits in a frame with its record
+  // header, to the frame of records being filled, sending the frame first
+  // if it won't fit.  Called with SWP_coalesceMutex held.  The mutex is
+  // let go while a frame is sent, and others may have packed messages
+  // into the next one meanwhile.
+  unsigned char *record;
+
+  while (SWP_coalesceLength + SWP_RECORD_HEADER + length > SWP_payloadSize)
+    SWP_coalesceSend ();
+
+  // the deadline runs from the first message in the frame
+  if (SWP_coalesceLength == 0)
+    {
+      SWP_coalesceEnqueued = enqueued;
+      clock_gettime (CLOCK_MONOTONIC,&SWP_coalesceDeadline);
+      SWP_coalesceDeadline.tv_nsec += SWP_coalesceUsecs * 1000L;
+      SWP_coalesceDeadline.tv_sec += SWP_coalesceDeadline.tv_nsec / 1000000000;
+      SWP_coalesceDeadline.tv_nsec %= 1000000000;
+      pthread_cond_signal (&SWP_coalesceStarted);
+    }
+
+  record = SWP_coalesceBuf + SWP_coalesceLength;
+  record[0] = length >> 8;
+  record[1] = length & 0xff;
+  memcpy (record + SWP_RECORD_HEADER,buf,length);
+  SWP_coalesceLength += SWP_RECORD_HEADER + length;
+  SWP_coalesceCount++;
+
+  // a frame with no room for another record goes now
+  if (SWP_coalesceLength + SWP_RECORD_HEADER >= SWP_payloadSize)
+    SWP_coalesceSend ();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_coalesceSend
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_coalesceSend (void)
+{
+  // send the frame of records being filled, if there is one.  Called with
+  // SWP_coalesceMutex held, which is let go while the frame waits for its
+  // turn and is sent, so the buffer starts out empty for others.
+  unsigned char frame [SWP_PAYLOAD_SIZE];
+  long long enqueued;
+  int length,count;
+
+  if (SWP_coalesceLength == 0)
+    return;
+  length = SWP_coalesceLength;
+  count = SWP_coalesceCount;
+  enqueued = SWP_coalesceEnqueued;
+  memcpy (frame,SWP_coalesceBuf,length);
+  SWP_coalesceLength = 0;
+  SWP_coalesceCount = 0;
+
+  SWP_coalesceTurn (SWP_sendTicket++);
+  SWP_sendFrame ((const char *)frame,length,1,enqueued,count);
+  SWP_coalesceDone ();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_coalesceTurn
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_coalesceTurn (unsigned long ticket)
+{
+  // wait, with SWP_coalesceMutex held, until it's the turn of ticket to
+  // send, then let go of the mutex
+  while (SWP_sendServing != ticket)
+    pthread_cond_wait (&SWP_sendTurn,&SWP_coalesceMutex);
+  pthread_mutex_unlock (&SWP_coalesceMutex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_coalesceDone
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_coalesceDone (void)
+{
+  // take SWP_coalesceMutex again once the frames of our turn have gone,
+  // and pass the turn on
+  pthread_mutex_lock (&SWP_coalesceMutex);
+  SWP_sendServing++;
+  pthread_cond_broadcast (&SWP_sendTurn);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_coalesceTimer
+//
+///////////////////////////////////////////////////////////////////////////////
+void *SWP_coalesceTimer (void *arg)
+{
+  // the thread that sends a frame of records once its deadline passes,
+  // if it hasn't filled up by then
+  struct timespec now;
+
+  pthread_mutex_lock (&SWP_coalesceMutex);
+  while (!SWP_closing)
+    {
+      if (SWP_coalesceLength == 0)
+	{
+	  pthread_cond_wait (&SWP_coalesceStarted,&SWP_coalesceMutex);
+	  continue;
+	}
+      clock_gettime (CLOCK_MONOTONIC,&now);
+      if (now.tv_sec > SWP_coalesceDeadline.tv_sec ||
+	  (now.tv_sec == SWP_coalesceDeadline.tv_sec &&
+	   now.tv_nsec >= SWP_coalesceDeadline.tv_nsec))
+	SWP_coalesceSend ();
+      else
+	pthread_cond_timedwait (&SWP_coalesceStarted,&SWP_coalesceMutex,
+				&SWP_coalesceDeadline);
+    }
+  pthread_mutex_unlock (&SWP_coalesceMutex);
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_transmit
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_transmit (int slot)
+{
+  // send the frame in the given slot of the send buffer, on its stripe.
+  // A frame whose payload wasn't copied is gathered from its header and
+  // the caller's buffer.
+  int stripe;
+
+  stripe = slot % SWP_stripesInUse;
+  if (!SWP_sendData[slot])
+    SWP_sendOut (stripe,SWP_sendBuffer[slot],SWP_sendLength[slot],0,0);
+  else
+    SWP_sendOut (stripe,SWP_sendBuffer[slot],
+		 SWP_sendLength[slot] - SWP_sendDataLen[slot],
+		 SWP_sendData[slot],SWP_sendDataLen[slot]);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_sendOut
+//
+///////////////////////////////////////////////////////////////////////////////
+int SWP_sendOut (int stripe, const unsigned char *wire, int size,
+		 const unsigned char *data, int dataLen)
+{
+  // send one of our frames on the given stripe: size bytes from wire,
+  // followed by dataLen bytes from data if data isn't null.  If the
+  // receiver is on this host the frame goes through shared memory
+  // instead.  Returns as sendto does.
+  struct msghdr msg;
+  struct iovec iov[2];
+
+  if (SWP_sendShm)
+    return SWP_shmSend (SWP_sendShm,SWP_stripeSock[stripe],wire,size,
+			data,dataLen);
+  if (SWP_sendRing)
+    return SWP_ringSend (SWP_sendRing,SWP_stripeSock[stripe],
+			 &SWP_stripeAddr[stripe],wire,size,data,dataLen);
+  if (!data)
+    return US_sendto(SWP_stripeSock[stripe],(char *)wire,size,0,
+		     (struct sockaddr *)&SWP_stripeAddr[stripe],
+		     sizeof(SWP_stripeAddr[stripe]));
+
+  iov[0].iov_base = (void *)wire;
+  iov[0].iov_len = size;
+  iov[1].iov_base = (void *)data;
+  iov[1].iov_len = dataLen;
+  memset (&msg,0,sizeof(msg));
+  msg.msg_name = &SWP_stripeAddr[stripe];
+  msg.msg_namelen = sizeof(SWP_stripeAddr[stripe]);
+  msg.msg_iov = iov;
+  msg.msg_iovlen = 2;
+  return US_sendmsg(SWP_stripeSock[stripe],&msg,0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_answer
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_answer (int sock, const unsigned char *wire, int size,
+		 struct sockaddr_in *toAddr)
+{
+  // send the receiver's answer to a frame that came in on socket sock back
+  // the way the frame came
+  if (sock == SWP_SHM_SOCK)
+    SWP_shmSend (SWP_recvShm,SWP_recvDataSock,wire,size,0,0);
+  else if (SWP_recvRing)
+    SWP_ringSend (SWP_recvRing,sock,toAddr,wire,size,0,0);
+  else
+    US_sendto(sock,(char *)wire,size,0,
+	      (struct sockaddr *)toAddr,sizeof(*toAddr));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_shmSend
+//
+///////////////////////////////////////////////////////////////////////////////
+static int SWP_shmSend (struct SHM_channel *channel, int sock,
+			const unsigned char *wire, int size,
+			const unsigned char *data, int dataLen)
+{
+  // put a frame in a shared memory channel, as SWP_sendOut, with the
+  // errors that would be simulated on socket sock.  A frame that finds
+  // the channel full is lost, as it would be if a socket's buffer were.
+  unsigned char *slot;
+
+  if (!(slot = SHM_reserve (channel,size + dataLen)))
+    {
+      errno = ENOBUFS;
+      return -1;
+    }
+  memcpy (slot,wire,size);
+  if (data)
+    memcpy (slot + size,data,dataLen);
+  if (US_Garble (sock,(char *)slot,size + dataLen))
+    SHM_commit (channel,size + dataLen);
+  return size + dataLen;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_ringSend
+//
+///////////////////////////////////////////////////////////////////////////////
+static int SWP_ringSend (struct UR_ring *ring, int sock,
+			 struct sockaddr_in *toAddr,
+			 const unsigned char *wire, int size,
+			 const unsigned char *data, int dataLen)
+{
+  // queue a frame on a ring, to go from socket sock to toAddr, as
+  // SWP_shmSend puts one in a channel.  It's handed to the kernel by the
+  // next SWP_ringSubmit.
+  unsigned char *slot;
+
+  if (!(slot = UR_reserve (ring,size + dataLen)))
+    {
+      errno = ENOBUFS;
+      return -1;
+    }
+  memcpy (slot,wire,size);
+  if (data)
+    memcpy (slot + size,data,dataLen);
+  if (US_Garble (sock,(char *)slot,size + dataLen))
+    UR_send (ring,sock,toAddr,size + dataLen);
+  return size + dataLen;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_ringWanted
+//
+///////////////////////////////////////////////////////////////////////////////
+int SWP_ringWanted (void)
+{
+  // true iff the sockets are to be served through a ring.  An engine built
+  // for one backend knows which when it's compiled.
+  if (IoBackend::fixed)
+    return IoBackend::backend == SWP_BACKEND_URING;
+  return SWP_backend == SWP_BACKEND_URING;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_ringSubmit
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_ringSubmit (void)
+{
+  // hand the kernel whatever has been queued on the rings, a system call
+  // for each ring that has anything.  Called with the lock held, as it's
+  // about to be let go.
+  if (SWP_sendRing)
+    UR_submit (SWP_sendRing);
+  if (SWP_recvRing)
+    UR_submit (SWP_recvRing);
+}
+
+public:
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_flush
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_flush(void)
+{
+  sigset_t oldsigset;
+  long long submitted;
+
+  // messages queued by now must be sent before we go on
+  submitted = std::atomic_load (&SWP_queueSubmitted);
+  SWP_lock (&oldsigset);
+  while (SWP_queueSent < submitted)
+    SWP_wait (&oldsigset);
+
+  // and a frame of records being filled goes without waiting for its
+  // deadline, after any that are already on their way
+  if (SWP_coalesceUsecs)
+    {
+      SWP_unlock (&oldsigset);
+      pthread_mutex_lock (&SWP_coalesceMutex);
+      SWP_coalesceSend ();
+      while (SWP_sendServing != SWP_sendTicket)
+	pthread_cond_wait (&SWP_sendTurn,&SWP_coalesceMutex);
+      pthread_mutex_unlock (&SWP_coalesceMutex);
+      SWP_lock (&oldsigset);
+    }
+
+  // nothing more is coming for a partial block, so send its parity now
+  if (SWP_fecBlockCount > 0)
+    SWP_fecSendParity ();
+
+  // wait for everything to be acked, and for the handshake to be answered
+  // so the session can be resumed, unless we give up on the peer
+  while ((SWP_LAR != SWP_LFS || !SWP_sessionOpen) && !SWP_failed)
+    SWP_wait (&oldsigset);
+
+  SWP_unlock (&oldsigset);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_setFEC
+//
+///////////////////////////////////////////////////////////////////////////////
+int SWP_setFEC (int blockSize, int numParity)
+{
+  if (blockSize == 0)
+    {
+      SWP_fecK = SWP_fecM = 0;
+      return 0;
+    }
+
+  if (blockSize<1 || blockSize>FEC_MAX_BLOCK ||
+      numParity<1 || numParity>FEC_MAX_PARITY)
+    {
+      printf ("FEC block size or redundancy out of range\n");
+      return -1;
+    }
+
+  // start a fresh block with the new parameters
+  SWP_fecK = blockSize;
+  SWP_fecM = numParity;
+  if (SWP_SWS && SWP_fecK > SWP_SWS)
+    SWP_fecK = SWP_SWS;
+  SWP_fecBlockCount = 0;
+
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_setIntegrity
+//
+///////////////////////////////////////////////////////////////////////////////
+int SWP_setIntegrity (int policy)
+{
+  if (CK_size(policy) < 0)
+    {
+      printf ("Unknown integrity policy\n");
+      return -1;
+    }
+
+  SWP_checkPolicy = SWP_localPolicy = policy;
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_setPayloadSize
+//
+///////////////////////////////////////////////////////////////////////////////
+int SWP_setPayloadSize (int size, int probe)
+{
+  if (size<1 || size>SWP_PAYLOAD_SIZE)
+    {
+      printf ("Payload size out of range\n");
+      return -1;
+    }
+
+  SWP_localPayload = size;
+  SWP_probing = probe;
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_setSharedMemory
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_setSharedMemory (int on)
+{
+  SWP_localShm = (on != 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_setExitOnFailure
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_setExitOnFailure (int on)
+{
+  // whether a peer that stops answering ends the process, as it does by
+  // default.  If not, the engine fails instead: SWP_send and SWP_flush
+  // return without waiting, and SWP_recv returns length -1 once it has
+  // nothing left to hand over.
+  SWP_exitOnFailure = (on != 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_setSendQueue
+//
+///////////////////////////////////////////////////////////////////////////////
+int SWP_setSendQueue (int numMessages)
+{
+  if (numMessages<2 || numMessages>65536 ||
+      (numMessages & (numMessages - 1)) != 0)
+    {
+      printf ("Send queue size out of range\n");
+      return -1;
+    }
+
+  SWP_queueSize = numMessages;
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_setTrace
+//
+///////////////////////////////////////////////////////////////////////////////
+int SWP_setTrace (const char *fileName, int eventsPerThread)
+{
+  if (TR_open (fileName,eventsPerThread) < 0)
+    return -1;
+
+  // the trace is written when the program exits
+  SWP_tracing = 1;
+  SWP_wantTrace ();
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_setCompression
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_setCompression (int on)
+{
+  SWP_localCompress = (on != 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_setCoalescing
+//
+///////////////////////////////////////////////////////////////////////////////
+int SWP_setCoalescing (int deadlineUsecs)
+{
+  if (deadlineUsecs<0 || deadlineUsecs>1000000)
+    {
+      printf ("Coalescing deadline out of range\n");
+      return -1;
+    }
+
+  SWP_coalesceUsecs = deadlineUsecs;
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_setBackend
+//
+///////////////////////////////////////////////////////////////////////////////
+int SWP_setBackend (int backend)
+{
+  if (backend != SWP_BACKEND_SOCKETS && backend != SWP_BACKEND_URING)
+    {
+      printf ("No such I/O backend\n");
+      return -1;
+    }
+  if (IoBackend::fixed && backend != IoBackend::backend)
+    {
+      printf ("The engine is built for the other I/O backend\n");
+      return -1;
+    }
+
+  SWP_backend = backend;
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_setStripes
+//
+///////////////////////////////////////////////////////////////////////////////
+int SWP_setStripes (int numStripes)
+{
+  if (numStripes<1 || numStripes>SWP_MAX_STRIPES)
+    {
+      printf ("Number of stripes out of range\n");
+      return -1;
+    }
+
+  SWP_numStripes = numStripes;
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_setResumeToken
+//
+///////////////////////////////////////////////////////////////////////////////
+int SWP_setResumeToken (struct SWP_resumeToken *token)
+{
+  if (!token)
+    {
+      SWP_resuming = 0;
+      return 0;
+    }
+
+  if (token->windowSize<1 || token->windowSize>WindowPow2 ||
+      token->payloadSize<1 || token->payloadSize>SWP_PAYLOAD_SIZE ||
+      CK_size(token->checkPolicy) < 0 ||
+      token->stripes<1 || token->stripes>SWP_MAX_STRIPES)
+    {
+      printf ("Resumption token is not usable\n");
+      return -1;
+    }
+
+  SWP_session = *token;
+  SWP_resuming = 1;
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_getResumeToken
+//
+///////////////////////////////////////////////////////////////////////////////
+int SWP_getResumeToken (struct SWP_resumeToken *token)
+{
+  if (!SWP_sessionOpen)
+    return -1;
+
+  *token = SWP_session;
+  return SWP_resumed;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_getStats
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_getStats (struct SWP_stats *stats)
+{
+  *stats = SWP_stats;
+  stats->srttUsecs = SWP_srtt * 1000000;
+  stats->compressUsecs = SWP_compressNsecs / 1000;
+  stats->decompressUsecs = SWP_decompressNsecs / 1000;
+  stats->payloadSize = SWP_sending ? SWP_payloadSize : SWP_recvPayloadSize;
+  stats->sharedMemory = SWP_sendShm != 0;
+  stats->ioUring = SWP_sendRing != 0 || SWP_recvRing != 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_setPacing
+//
+///////////////////////////////////////////////////////////////////////////////
+int SWP_setPacing (long bytesPerSec, int maxBurst)
+{
+  if (bytesPerSec < 0 || maxBurst < 0)
+    {
+      printf ("Pacing rate or burst out of range\n");
+      return -1;
+    }
+
+  // start with a full bucket
+  SWP_paceRate = bytesPerSec;
+  SWP_paceBurst = maxBurst;
+  SWP_paceTokens = maxBurst * SWP_frameSize ();
+  clock_gettime (CLOCK_MONOTONIC,&SWP_paceLast);
+
+  return 0;
+}
+
+
+private:
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_SIGIO
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_SIGIO (int signalType)
+{
+  // SIGIO doesn't say which socket is ready, so a process that both sends
+  // and receives looks for acks and for data.  Sockets served by a ring
+  // are left to it.
+  if (SWP_sending && !SWP_sendRing)
+    SWP_ackSIGIO (signalType);
+  if (SWP_receiving && !SWP_recvRing)
+    SWP_dataSIGIO (signalType);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_ackSIGIO
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_ackSIGIO (int signalType)
+{
+  // SIGIO callback for received ack
+  int ackSize;
+  struct sockaddr_in SWP_recvAckAddr;
+  unsigned char SWP_recvAck [SWP_HEADER_SIZE + SWP_MAX_CHECK_SIZE +
+			     SWP_HANDSHAKE_SIZE];
+  struct SWP_header header;
+  int offset;
+  long long stamp;
+
+  pthread_mutex_lock (&SWP_mutex);
+
+  // the kernel's stamp for a frame sent raises SIGIO too
+  if (SWP_traceSent)
+    SWP_traceDrain (0);
+
+  // receive messages
+  while (1)
+    {
+      ackSize = SWP_recvStamped(SWP_sendDataSock,
+				SWP_recvAck,sizeof(SWP_recvAck),
+				&SWP_recvAckAddr,&stamp);
+
+      // exit loop if no more acks have arrived
+      if (ackSize == -1 && errno==EAGAIN)
+	break;
+
+      // discard ack if it's the wrong size or there was an error in
+      // transmission
+      if ((offset = SWP_decodeFrame(SWP_recvAck,ackSize,&header,
+				    SWP_checkPolicy,SWP_altPolicy)) < 0)
+	{
+#ifdef DEBUG
+	  printf ("SWP_ackSIGIO:received ack is bad\n");
+#endif
+	  continue;
+	}
+
+      if (SWP_tracing && header.type == SWP_ACK_FRAME)
+	TR_record (TR_ACK,header.seqNum,0,0,stamp,stamp != 0);
+      SWP_acceptAck (&header,SWP_recvAck+offset);
+    }
+
+  // the signal may have come to a thread other than the one waiting
+  SWP_wake ();
+  pthread_mutex_unlock (&SWP_mutex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_ackStripe
+//
+///////////////////////////////////////////////////////////////////////////////
+void *SWP_ackStripe (void *arg)
+{
+  // the thread that takes the acks coming in on one of the other stripes
+  int stripe = (long)arg;
+  int ackSize;
+  unsigned char SWP_recvAck [SWP_HEADER_SIZE + SWP_MAX_CHECK_SIZE +
+			     SWP_HANDSHAKE_SIZE];
+  struct SWP_header header;
+  int offset;
+  long long stamp;
+
+  while (1)
+    {
+      ackSize = SWP_recvStamped(SWP_stripeSock[stripe],
+				SWP_recvAck,sizeof(SWP_recvAck),0,&stamp);
+      if (SWP_closing)
+	break;
+
+      // keep the stamps of frames sent from piling up behind the acks
+      if (SWP_traceSent)
+	SWP_traceDrain (stripe);
+
+      // the check is made before taking the lock, so the stripes can make
+      // it at the same time
+      if ((offset = SWP_decodeFrame(SWP_recvAck,ackSize,&header,
+				    SWP_checkPolicy,SWP_altPolicy)) < 0)
+	continue;
+      if (SWP_tracing && header.type == SWP_ACK_FRAME)
+	TR_record (TR_ACK,header.seqNum,stripe,0,stamp,stamp != 0);
+
+      pthread_mutex_lock (&SWP_mutex);
+      SWP_acceptAck (&header,SWP_recvAck+offset);
+      SWP_wake ();
+      pthread_mutex_unlock (&SWP_mutex);
+    }
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_ackShm
+//
+///////////////////////////////////////////////////////////////////////////////
+void *SWP_ackShm (void *arg)
+{
+  // the thread that takes the answers a receiver on this host puts in the
+  // shared memory channel we send through
+  int ackSize;
+  struct SWP_header header;
+  unsigned char *wire;
+  int offset;
+
+  while (1)
+    {
+      if (!(wire = SHM_next (SWP_sendShm,&ackSize)))
+	break;
+      pthread_mutex_lock (&SWP_mutex);
+      if ((offset = SWP_decodeFrame(wire,ackSize,&header,
+				    SWP_checkPolicy,SWP_altPolicy)) >= 0)
+	{
+	  if (SWP_tracing && header.type == SWP_ACK_FRAME)
+	    TR_record (TR_ACK,header.seqNum,0,0,0,0);
+	  SWP_acceptAck (&header,wire+offset);
+	  SWP_wake ();
+	}
+      pthread_mutex_unlock (&SWP_mutex);
+      SHM_release (SWP_sendShm);
+    }
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_ackUring
+//
+///////////////////////////////////////////////////////////////////////////////
+void *SWP_ackUring (void *arg)
+{
+  // the thread that takes the acks coming in on all the sender's stripes
+  // through its ring.  The receives are posted from here, so that the
+  // kernel finishes them here.  Each time it wakes it takes all that has
+  // come in, and what that sends goes to the kernel together as it lets
+  // go of the lock.
+  struct UR_datagram datagram;
+  struct SWP_header header;
+  int offset,accepted,i;
+
+  pthread_mutex_lock (&SWP_mutex);
+  for (i=0;i<SWP_numStripes;i++)
+    UR_recv (SWP_sendRing,SWP_stripeSock[i],i);
+  SWP_ringSubmit ();
+  pthread_mutex_unlock (&SWP_mutex);
+
+  while (1)
+    {
+      UR_wait (SWP_sendRing);
+      if (SWP_closing)
+	break;
+      pthread_mutex_lock (&SWP_mutex);
+      for (accepted=0;UR_next (SWP_sendRing,&datagram);)
+	{
+	  if ((offset = SWP_decodeFrame(datagram.data,datagram.length,&header,
+					SWP_checkPolicy,SWP_altPolicy)) >= 0)
+	    {
+	      SWP_acceptAck (&header,datagram.data+offset);
+	      accepted = 1;
+	    }
+	  UR_done (SWP_sendRing,&datagram);
+	}
+      if (accepted)
+	SWP_wake ();
+      SWP_ringSubmit ();
+      pthread_mutex_unlock (&SWP_mutex);
+    }
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_acceptAck
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_acceptAck (struct SWP_header *header, unsigned char *payload)
+{
+  // act on a frame that came in on one of the sender's stripes and passed
+  // its check.  Called with the lock held.
+
+  // the answer to our handshake settles the session's parameters
+  if (header->type == SWP_SYNACK_FRAME)
+    {
+      SWP_acceptSynAck (header,payload);
+      return;
+    }
+  if (header->type == SWP_PROBEACK_FRAME)
+    {
+      SWP_acceptProbeAck (header);
+      return;
+    }
+  if (header->type != SWP_ACK_FRAME)
+    return;
+
+  // ignore if we weren't expecting this ack
+  if (!SWP_inWindow (SWP_LAR,SWP_LFS,header->seqNum))
+    return;
+
+  // measure the round trip time, unless the frame was resent, in which
+  // case we can't tell which transmission is being acked
+  if (SWP_numTimeouts[SWP_slot (header->seqNum)] == 0)
+    SWP_rttSample (header->seqNum);
+
+  // ack received so cancel timeouts for messages acked and adjust send
+  // window
+  while (SWP_LAR != header->seqNum)
+    {
+      SWP_LAR = SWP_seq (SWP_LAR + 1);
+      SWP_clearSendTimeout (SWP_LAR);
+      SWP_sendSlotsAvail++;
+    }
+
+  // there may be buffer space now
+  SWP_sendWait = (SWP_sendSlotsAvail <= 0);
+}
+ 
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_sendTimer
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_sendTimer(int signalType)
+{
+  int i,j;
+  struct itimerval timeVal;
+  struct timeval currTime;
+  // timer ticked, which means one tenth of a second has passed.
+
+  pthread_mutex_lock (&SWP_mutex);
+
+  // only a sender that hasn't given up has anything to time
+  if (!SWP_sending || SWP_failed)
+    {
+      pthread_mutex_unlock (&SWP_mutex);
+      return;
+    }
+
+  // get current time
+  gettimeofday (&currTime,0);
+
+  // collect the kernel's stamps for frames sent on the other stripes
+  if (SWP_traceSent)
+    for (i=1;i<SWP_stripesInUse;i++)
+      SWP_traceDrain (i);
+
+  // resend the handshake if it hasn't been answered in time
+  if (!SWP_sessionOpen && !timercmp(&currTime,&SWP_synTimeout,<))
+    {
+      if (++SWP_synTimeouts > SWP_MAX_TIMEOUTS) {
+	SWP_giveUp ();
+	pthread_mutex_unlock (&SWP_mutex);
+	return;
+      }
+      SWP_sendSyn ();
+    }
+
+  // look for a bigger payload size
+  if (SWP_probing && SWP_sessionOpen)
+    SWP_probe (&currTime);
+
+  // examine all frames waiting for an ack to see if any timeouts have
+  // expired
+  for (j=SWP_seq (SWP_LAR+1);
+       SWP_inWindow(SWP_LAR,SWP_LFS,j);
+       j=SWP_seq (j+1))
+    {
+      i = SWP_slot (j);
+
+      // go on to next seqNum if this timer not even set
+      if (!SWP_sendTimeoutSet[i])
+	continue;
+
+      // still nothing to do unless the timeout time has passed
+      if (timercmp(&currTime,&SWP_sendTimeout[i],<))
+	continue;
+
+      // timeout has occurred, so handle it.  If the bucket is empty the
+      // frame stays timed out and is resent on a later tick.
+      if (SWP_paceBurst && !SWP_paceTake(SWP_sendLength[i],0))
+	continue;
+
+      // increment number of timeouts
+      SWP_numTimeouts[i]++;
+      
+      // if too many timeouts we'll just give up
+      if (SWP_numTimeouts[i] > SWP_MAX_TIMEOUTS) {
+	SWP_giveUp ();
+	break;
+      }
+      
+      // resend message
+      if (SWP_tracing)
+	TR_record (TR_RETRANSMIT,j,i % SWP_stripesInUse,
+		   SWP_sendLength[i] - SWP_HEADER_SIZE -
+		   SWP_checkSize(SWP_checkPolicy),0,0);
+      SWP_transmit (i);
+      SWP_stats.framesRetransmitted++;
+#ifdef DEBUG
+      printf ("SWP_SendTimeout: Resent message %d\n",j);
+#endif
+
+      // reset timeout
+      SWP_setSendTimeout (j);
+    }
+
+  // frames resent on this tick go to the kernel together
+  SWP_ringSubmit ();
+  pthread_mutex_unlock (&SWP_mutex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_giveUp
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_giveUp (void)
+{
+  // the peer has stopped answering.  Unless we may carry on without it,
+  // that's the end of the process; otherwise the engine fails, and those
+  // waiting on it are woken to find out.  Called with the lock held.
+  printf ("Too many timeouts - giving up\n");
+  if (SWP_exitOnFailure)
+    exit(1);
+  SWP_failed = 1;
+  SWP_wake ();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_setSendTimeout
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_setSendTimeout (int seqNum)
+{
+  // set the send timeout time to be the current time + SWP_TIMEOUT
+
+  sigset_t oldsigset,sigset;
+
+  // first, block SIGALRM and SIGIO so the timer and asynchronous input
+  // can't happen while we're playing with the timeout structures
+  sigemptyset (&sigset);
+  sigaddset (&sigset,SIGALRM);
+  sigaddset (&sigset,SIGIO);
+  sigprocmask (SIG_BLOCK,&sigset,&oldsigset);
+  
+  SWP_timeoutFromNow (&SWP_sendTimeout[SWP_slot (seqNum)]);
+
+  // the timeout is now set
+  SWP_sendTimeoutSet[SWP_slot (seqNum)] = 1;
+
+  // restore signal mask
+  sigprocmask (SIG_SETMASK,&oldsigset,0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_timeoutFromNow
+//
+///////////////////////////////////////////////////////////////////////////////
+static void SWP_timeoutFromNow (struct timeval *when)
+{
+  // get the current time
+  gettimeofday (when,0);
+
+  // add SWP_TIMEOUT constants to the time to get the time the timeout
+  // expires
+  when->tv_usec += SWP_TIMEOUT_USECS;
+  if (when->tv_usec >= 1000000)
+    {
+      when->tv_sec++;
+      when->tv_usec -= 1000000;
+    }
+  when->tv_sec += SWP_TIMEOUT_SECS;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_clearSendTimeout
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_clearSendTimeout (int seqNum)
+{
+  // clear the send timeout
+
+  sigset_t oldsigset,sigset;
+
+  // first, block SIGALRM and SIGIO so the timer and asynchronous input
+  // can't happen while we're playing with the timeout structures
+  sigemptyset (&sigset);
+  sigaddset (&sigset,SIGALRM);
+  sigaddset (&sigset,SIGIO);
+  sigprocmask (SIG_BLOCK,&sigset,&oldsigset);
+  
+  // the timeout is not set anymore
+  SWP_sendTimeoutSet[SWP_slot (seqNum)] = 0;
+
+  // restore signal mask
+  sigprocmask (SIG_SETMASK,&oldsigset,0);
+}
+
+public:
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_recvInit
+//
+///////////////////////////////////////////////////////////////////////////////
+int SWP_recvInit (short portNum,int winSize)
+{
+  struct sigaction handler;
+  sigset_t oldsigset;
+  struct timespec now;
+  struct sockaddr_in addr;
+  char name [32];
+  int size,i;
+
+  // set receive window and sequence sizes
+  if (winSize<1 || winSize>WindowPow2)
+    {
+      printf ("Receive Window size out of range\n");
+      return -1;
+    }
+  SWP_maxWindow = winSize;
+
+  // build address data structures
+  memset (&SWP_recvDataAddr, 0, sizeof(SWP_recvDataAddr));
+  SWP_recvDataAddr.sin_family = AF_INET;
+  SWP_recvDataAddr.sin_addr.s_addr = INADDR_ANY;
+  SWP_recvDataAddr.sin_port = htons(portNum);
+
+  // create socket for receiving data and bind it to port
+  if((SWP_recvDataSock = socket(PF_INET,SOCK_DGRAM,IPPROTO_UDP)) < 0){
+    perror("recvInit:socket");
+    return -1;
+  }
+  SWP_recvStripeSock[0] = SWP_recvDataSock;
+  SWP_recvSockets = 1;
+
+  if (bind (SWP_recvDataSock,(struct sockaddr *)&SWP_recvDataAddr,
+	    sizeof(SWP_recvDataAddr)) < 0){
+    perror("recvInit:bind");
+    return -1;
+  }
+
+  // and one for each other stripe, on the ports after portNum
+  for (i=1;i<SWP_numStripes;i++)
+    {
+      addr = SWP_recvDataAddr;
+      addr.sin_port = htons(portNum + i);
+      if((SWP_recvStripeSock[i] = socket(PF_INET,SOCK_DGRAM,IPPROTO_UDP)) < 0){
+	perror("recvInit:socket");
+	return -1;
+      }
+      SWP_recvSockets++;
+      if (bind (SWP_recvStripeSock[i],(struct sockaddr *)&addr,
+		sizeof(addr)) < 0){
+	perror("recvInit:bind");
+	return -1;
+      }
+    }
+
+  // make room in the sockets for a couple of windows of the biggest
+  // frames, which is more than the default with jumbo frames.  The kernel
+  // may give us less.
+  size = 2 * winSize * (SWP_HEADER_SIZE + SWP_MAX_CHECK_SIZE +
+			SWP_localPayload);
+  for (i=0;i<SWP_numStripes;i++)
+    setsockopt (SWP_recvStripeSock[i],SOL_SOCKET,SO_RCVBUF,&size,sizeof(size));
+
+  // have the kernel stamp frames as they come in
+  if (SWP_tracing)
+    for (i=0;i<SWP_numStripes;i++)
+      SWP_traceSocket (SWP_recvStripeSock[i],0);
+
+  // set up SIGIO handler for received data
+  handler.sa_handler = SWP_allSIGIO;
+  if (sigfillset (&handler.sa_mask) < 0){
+    perror("recvInit:sigfillset");
+    return -1;
+  }
+  handler.sa_flags = 0;
+  if (sigaction(SIGIO, &handler, 0) < 0){
+    perror("recvInit:sigaction:SIGIO");
+    return -1;
+  }
+
+  // the stripes may be served through a ring, as in SWP_sendInit
+  SWP_recvRing = 0;
+  if (SWP_ringWanted() && !SWP_tracing)
+    SWP_recvRing = UR_open (SWP_MAX_FRAME,SWP_HEADER_SIZE +
+			    SWP_MAX_CHECK_SIZE + SWP_HANDSHAKE_SIZE);
+
+  if (!SWP_recvRing && fcntl(SWP_recvDataSock, F_SETOWN, getpid()) < 0){
+    perror("recvInit:fcntl1 ");
+    return -1;
+  }
+  if (!SWP_recvRing &&
+      fcntl(SWP_recvDataSock, F_SETFL, O_NONBLOCK|FASYNC) < 0){
+    perror("recvInit:fcntl2 ");
+    return -1;
+  }
+
+  // there's no session until a sender's handshake arrives
+  SWP_recvSessionOpen = 0;
+  clock_gettime (CLOCK_REALTIME,&now);
+  SWP_tokenKey = ((unsigned long long)now.tv_sec << 32) ^ now.tv_nsec ^
+    ((unsigned long long)getpid() << 16);
+
+  // initialize Q
+  Q.front = Q.rear = Q.size = 0;
+
+  // we're waiting for data
+  SWP_recvWait = 1;
+
+  // the handlers may look at the receiver from here on
+  if (SWP_register () < 0)
+    return -1;
+  SWP_lock (&oldsigset);
+  SWP_receiving = 1;
+  SWP_unlock (&oldsigset);
+
+  // offer senders on this host a shared memory channel, if we may and
+  // can, and take what comes in on it in a thread of its own.  The name
+  // goes when we do.
+  snprintf (name,sizeof(name),SWP_SHM_NAME,(unsigned short)portNum);
+  SWP_recvShm = 0;
+  if (SWP_localShm && (SWP_recvShm = SHM_create (name)) != 0 &&
+      SWP_startThread (&Swp::SWP_dataShm,"shared memory") < 0)
+    return -1;
+
+  // as for the sender, a ring or a thread for each other stripe takes the
+  // frames
+  if (SWP_recvRing)
+    return SWP_startThread (&Swp::SWP_dataUring,"the ring");
+  return SWP_startStripes (&Swp::SWP_dataStripe);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_recv
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_recv (char *buf, int *length)
+{
+  sigset_t oldsigset;
+  unsigned char *record;
+
+  // take the lock while we look at Q, and wait for a message to come in.
+  // There's none to come once we've given up on the peer.
+  SWP_lock (&oldsigset);
+  while (SWP_recvWait && !SWP_failed)
+    SWP_wait (&oldsigset);
+  if (SWP_recvWait)
+    {
+      *length = -1;
+      SWP_unlock (&oldsigset);
+      return;
+    }
+
+  // remove item from Q
+  if (SWP_tracing && SWP_recordOffset == 0)
+    TR_record (TR_DELIVER,Q.data[Q.front].seqNum,0,Q.data[Q.front].length,
+	       0,0);
+  if (Q.data[Q.front].records)
+    {
+      // a frame of records is handed over a record at a time, and leaves
+      // Q with the last of them
+      record = Q.data[Q.front].data + SWP_recordOffset;
+      *length = (record[0] << 8) | record[1];
+      memmove (buf,record + SWP_RECORD_HEADER,*length);
+      SWP_recordOffset += SWP_RECORD_HEADER + *length;
+      if (SWP_recordOffset < Q.data[Q.front].length)
+	{
+	  SWP_unlock (&oldsigset);
+	  return;
+	}
+      SWP_recordOffset = 0;
+    }
+  else
+    {
+      memmove (buf,&Q.data[Q.front].data,Q.data[Q.front].length);
+      *length = Q.data[Q.front].length;
+    }
+  Q.front = (Q.front + 1) & (Q_DATASIZE - 1);
+  Q.size--;
+
+  // there's room in Q again for frames held back in the receive buffer
+  SWP_deliver ();
+
+  // we must wait for next message if no more frames in the buffer
+  SWP_recvWait = (Q.size==0);
+
+  SWP_unlock (&oldsigset);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_getPeer
+//
+///////////////////////////////////////////////////////////////////////////////
+int SWP_getPeer (char *hostname, int size)
+{
+  sigset_t oldsigset;
+  int ok;
+
+  SWP_lock (&oldsigset);
+  ok = SWP_recvSessionOpen &&
+    inet_ntop (AF_INET,&SWP_recvPeer.sin_addr,hostname,size) != 0;
+  SWP_unlock (&oldsigset);
+  return ok ? 0 : -1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_close
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_close (void)
+{
+  // stop the engine's threads and give back its sockets and memory.
+  // Whatever hasn't been flushed is lost, and the engine can't be set up
+  // again.  No other thread may be using it.
+  sigset_t oldsigset;
+  int i;
+
+  // once off the list, no handler runs on the engine
+  SWP_unregister ();
+
+  // wake each of our threads from what it waits on, and it stops when it
+  // sees we're closing.  A thread reading a socket is woken by shutting
+  // the socket down; one waiting on a ring looks for a stop now and then.
+  SWP_lock (&oldsigset);
+  SWP_closing = 1;
+  SWP_wake ();
+  SWP_unlock (&oldsigset);
+  if (SWP_queue)
+    sem_post (&SWP_queueFull);
+  pthread_mutex_lock (&SWP_coalesceMutex);
+  pthread_cond_broadcast (&SWP_coalesceStarted);
+  pthread_mutex_unlock (&SWP_coalesceMutex);
+  if (SWP_sendShm)
+    SHM_stop (SWP_sendShm);
+  if (SWP_recvShm)
+    SHM_stop (SWP_recvShm);
+  if (SWP_sendRing)
+    UR_stop (SWP_sendRing);
+  if (SWP_recvRing)
+    UR_stop (SWP_recvRing);
+  for (i=0;i<SWP_sendSockets;i++)
+    shutdown (SWP_stripeSock[i],SHUT_RDWR);
+  for (i=0;i<SWP_recvSockets;i++)
+    shutdown (SWP_recvStripeSock[i],SHUT_RDWR);
+  for (i=0;i<SWP_numThreads;i++)
+    pthread_join (SWP_threads[i].thread,0);
+  SWP_numThreads = 0;
+
+  // then nothing else uses what they used
+  for (i=0;i<SWP_sendSockets;i++)
+    close (SWP_stripeSock[i]);
+  for (i=0;i<SWP_recvSockets;i++)
+    close (SWP_recvStripeSock[i]);
+  SWP_sendSockets = SWP_recvSockets = 0;
+  if (SWP_sendRing)
+    UR_close (SWP_sendRing);
+  if (SWP_recvRing)
+    UR_close (SWP_recvRing);
+  SWP_sendRing = SWP_recvRing = 0;
+  if (SWP_sendShm)
+    SHM_close (SWP_sendShm);
+  if (SWP_recvShm)
+    {
+      SHM_remove (SWP_recvShm);
+      SHM_close (SWP_recvShm);
+    }
+  SWP_sendShm = SWP_recvShm = 0;
+  if (SWP_queue)
+    {
+      sem_destroy (&SWP_queueFull);
+      sem_destroy (&SWP_queueFree);
+    }
+  free (SWP_queue);
+  free (SWP_queueData);
+  free (SWP_parityBuffer);
+  SWP_queue = 0;
+  SWP_queueData = 0;
+  SWP_parityBuffer = 0;
+}
+
+private:
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_dataSIGIO
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_dataSIGIO (int signalType)
+{
+  // SIGIO callback for received data
+  int dataSize;
+  int offset,legacy;
+  struct sockaddr_in fromAddr;
+  struct SWP_header header;
+  unsigned char wire [SWP_MAX_FRAME];
+  long long stamp;
+
+  pthread_mutex_lock (&SWP_mutex);
+
+  while (1)
+    {
+      // receive message
+      dataSize = SWP_recvStamped(SWP_recvDataSock,wire,sizeof(wire),
+				 &fromAddr,&stamp);
+
+      // exit loop if no more data has arrived
+      if (dataSize == -1 && errno==EAGAIN)
+	break;
+
+      // discard message if it's the wrong size or there was an error in
+      // transmission
+      if ((offset = SWP_decodeData(wire,dataSize,&header,&legacy)) < 0)
+	{
+	  SWP_stats.badFrames++;
+	  continue;
+	}
+
+      if (SWP_tracing && header.type == SWP_DATA_FRAME)
+	TR_record (TR_ARRIVE,header.seqNum,0,header.length,stamp,stamp != 0);
+      SWP_acceptData (SWP_recvDataSock,&header,wire+offset,dataSize-offset,
+		      legacy,&fromAddr);
+    }
+
+  // the signal may have come to a thread other than the one waiting
+  SWP_wake ();
+  pthread_mutex_unlock (&SWP_mutex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_dataStripe
+//
+///////////////////////////////////////////////////////////////////////////////
+void *SWP_dataStripe (void *arg)
+{
+  // the thread that takes the frames coming in on one of the other stripes
+  int stripe = (long)arg;
+  int dataSize;
+  int offset,legacy;
+  struct sockaddr_in fromAddr;
+  struct SWP_header header;
+  unsigned char wire [SWP_MAX_FRAME];
+  long long stamp;
+
+  while (1)
+    {
+      dataSize = SWP_recvStamped(SWP_recvStripeSock[stripe],wire,sizeof(wire),
+				 &fromAddr,&stamp);
+      if (SWP_closing)
+	break;
+
+      // the check is made before taking the lock, so the stripes can make
+      // it at the same time.  The session's policy only changes in the
+      // handshake, which comes in on stripe 0.
+      offset = SWP_decodeData(wire,dataSize,&header,&legacy);
+      if (SWP_tracing && offset >= 0 && header.type == SWP_DATA_FRAME)
+	TR_record (TR_ARRIVE,header.seqNum,stripe,header.length,stamp,
+		   stamp != 0);
+
+      pthread_mutex_lock (&SWP_mutex);
+      if (offset < 0)
+	SWP_stats.badFrames++;
+      else
+	{
+	  SWP_acceptData (SWP_recvStripeSock[stripe],&header,wire+offset,
+			  dataSize-offset,legacy,&fromAddr);
+	  SWP_wake ();
+	}
+      pthread_mutex_unlock (&SWP_mutex);
+    }
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_dataShm
+//
+///////////////////////////////////////////////////////////////////////////////
+void *SWP_dataShm (void *arg)
+{
+  // the thread that takes the frames senders on this host put in our
+  // shared memory channel.  Each is handled where it lies in the channel,
+  // and answered through the channel.
+  int dataSize;
+  int offset,legacy;
+  struct sockaddr_in fromAddr;
+  struct SWP_header header;
+  unsigned char *wire;
+
+  while (1)
+    {
+      if (!(wire = SHM_next (SWP_recvShm,&dataSize)))
+	break;
+      SHM_peer (SWP_recvShm,&fromAddr);
+
+      // as on a stripe, the check is made before taking the lock.  The
+      // handshake that changes the policy comes through this thread too.
+      offset = SWP_decodeData(wire,dataSize,&header,&legacy);
+      if (SWP_tracing && offset >= 0 && header.type == SWP_DATA_FRAME)
+	TR_record (TR_ARRIVE,header.seqNum,0,header.length,0,0);
+
+      pthread_mutex_lock (&SWP_mutex);
+      if (offset < 0)
+	SWP_stats.badFrames++;
+      else
+	{
+	  SWP_acceptData (SWP_SHM_SOCK,&header,wire+offset,dataSize-offset,
+			  legacy,&fromAddr);
+	  SWP_wake ();
+	}
+      pthread_mutex_unlock (&SWP_mutex);
+      SHM_release (SWP_recvShm);
+    }
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_dataUring
+//
+///////////////////////////////////////////////////////////////////////////////
+void *SWP_dataUring (void *arg)
+{
+  // the thread that takes the frames coming in on all the receiver's
+  // stripes through its ring, as SWP_ackUring takes acks.  The answers to
+  // a batch of frames go to the kernel together.
+  struct UR_datagram datagram;
+  struct SWP_header header;
+  int offset,legacy,accepted,i;
+
+  pthread_mutex_lock (&SWP_mutex);
+  for (i=0;i<SWP_numStripes;i++)
+    UR_recv (SWP_recvRing,SWP_recvStripeSock[i],i);
+  SWP_ringSubmit ();
+  pthread_mutex_unlock (&SWP_mutex);
+
+  while (1)
+    {
+      UR_wait (SWP_recvRing);
+      if (SWP_closing)
+	break;
+      pthread_mutex_lock (&SWP_mutex);
+      for (accepted=0;UR_next (SWP_recvRing,&datagram);)
+	{
+	  if ((offset = SWP_decodeData(datagram.data,datagram.length,&header,
+				       &legacy)) < 0)
+	    SWP_stats.badFrames++;
+	  else
+	    {
+	      SWP_acceptData (SWP_recvStripeSock[datagram.tag],&header,
+			      datagram.data+offset,datagram.length-offset,
+			      legacy,&datagram.from);
+	      accepted = 1;
+	    }
+	  UR_done (SWP_recvRing,&datagram);
+	}
+      if (accepted)
+	SWP_wake ();
+      SWP_ringSubmit ();
+      pthread_mutex_unlock (&SWP_mutex);
+    }
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_decodeData
+//
+///////////////////////////////////////////////////////////////////////////////
+int SWP_decodeData (unsigned char *wire, int size,
+		    struct SWP_header *header, int *legacy)
+{
+  // as SWP_decodeFrame, for a frame that came in on one of the receiver's
+  // stripes.  Frames in the old layout are still understood; legacy is
+  // set if the frame was one.
+  int offset;
+
+  *legacy = 0;
+  if ((offset = SWP_decodeFrame(wire,size,header,
+				SWP_recvPolicy,SWP_recvAltPolicy)) < 0)
+    {
+      offset = SWP_decodeLegacy(wire,size,header);
+      *legacy = 1;
+    }
+  return offset;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_acceptData
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_acceptData (int sock, struct SWP_header *header,
+		     unsigned char *payload, int payloadSize,
+		     int legacy, struct sockaddr_in *fromAddr)
+{
+  // act on a frame that came in on socket sock and passed its check, and
+  // answer it on the same socket.  Called with the lock held.
+  struct SWP_dataMsg *msg;
+  unsigned char wire [SWP_HEADER_SIZE + SWP_MAX_CHECK_SIZE];
+  int size,slot,lfr;
+
+  // another sender has to wait until the session's one has gone quiet;
+  // its handshakes are resent until then
+  if (SWP_peerBusy(sock,fromAddr))
+    return;
+
+  // a handshake starts a session, or is a resent one we must answer
+  // again
+  if (header->type == SWP_SYN_FRAME)
+    {
+      SWP_acceptSyn (sock,header,payload,fromAddr);
+      return;
+    }
+
+  // a legacy sender doesn't shake hands, so its first frame starts a
+  // session in the sequence space it uses
+  if (legacy && (!SWP_recvSessionOpen || !SWP_fromPeer(sock,fromAddr)))
+    {
+      SWP_openSession (0,2 * SWP_maxWindow,SWP_maxWindow);
+      SWP_recvPeer = *fromAddr;
+      SWP_sessionLegacy = 1;
+    }
+
+  // drop frames that aren't part of the session
+  if (!SWP_recvSessionOpen || legacy != SWP_sessionLegacy ||
+      header->seqNum >= SWP_ReceiveSize || !SWP_fromPeer(sock,fromAddr))
+    return;
+  clock_gettime (CLOCK_MONOTONIC,&SWP_recvHeard);
+
+  // a probe got through, so say so
+  if (header->type == SWP_PROBE_FRAME)
+    {
+      header->type = SWP_PROBEACK_FRAME;
+      header->flags = 0;
+      size = SWP_encodeFrame (wire,header,0,0);
+      SWP_answer (sock,wire,size,fromAddr);
+      return;
+    }
+
+  // parity frames aren't acked; they may let us rebuild lost frames,
+  // which are.  Otherwise the last frames of a transfer, if rebuilt, would
+  // only be acked once they had been resent.
+  if (header->type == SWP_PARITY_FRAME)
+    {
+      lfr = SWP_LFR;
+      SWP_fecStore (header,payload,payloadSize);
+      SWP_deliver ();
+      if (SWP_LFR != lfr)
+	SWP_sendAck (sock,fromAddr,legacy);
+      return;
+    }
+  if (header->type != SWP_DATA_FRAME)
+    return;
+
+  // buffer the frame if it's in the window and we don't have it yet,
+  // then pass on any frames that are now in order
+  slot = SWP_slot (header->seqNum);
+  if (SWP_inWindow(SWP_LFR,SWP_LAF,header->seqNum) &&
+      !SWP_haveFrame (slot))
+    {
+      msg = &SWP_receiveBuffer[slot];
+      msg->seqNum = header->seqNum;
+      msg->type = SWP_DATA_FRAME;
+      msg->records = (header->flags & SWP_FLAG_RECORDS) != 0;
+      if (header->flags & SWP_FLAG_COMPRESS)
+	{
+	  // a frame that passed its check but won't decompress is dropped
+	  // like any other bad frame
+	  if ((msg->length = SWP_decompress (payload,header->length,
+					     msg->data)) < 0)
+	    {
+	      SWP_stats.badFrames++;
+	      return;
+	    }
+	}
+      else
+	{
+	  msg->length = header->length;
+	  memmove (msg->data,payload,header->length);
+	}
+      if (msg->records && !SWP_recordsValid (msg->data,msg->length))
+	{
+	  SWP_stats.badFrames++;
+	  return;
+	}
+      SWP_markFrame (slot);
+      SWP_stats.framesReceived++;
+
+      // this frame may be what a stored parity frame was waiting for
+      if (SWP_fecBlockOf[slot] >= 0)
+	SWP_fecRecover (SWP_fecBlockOf[slot]);
+
+      SWP_deliver ();
+    }
+
+  // acknowledge everything received in order so far
+  SWP_sendAck (sock,fromAddr,legacy);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_sendAck
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_sendAck (int sock, struct sockaddr_in *toAddr, int legacy)
+{
+  // acknowledge every frame up to SWP_LFR on socket sock, in the old
+  // layout if the frame we're answering was in the old layout
+  struct SWP_header header;
+  struct SWP_legacyAckMsg legacyAck;
+  unsigned char wire [SWP_HEADER_SIZE + SWP_MAX_CHECK_SIZE];
+  int size;
+
+  if (legacy)
+    {
+      memset (&legacyAck,0,sizeof(legacyAck));
+      legacyAck.ackNum = SWP_LFR;
+      legacyAck.crc = htonl(calcCRC((unsigned char *)&legacyAck,
+				    sizeof(legacyAck)));
+      SWP_answer (sock,(unsigned char *)&legacyAck,sizeof(legacyAck),
+		  toAddr);
+      return;
+    }
+
+  header.type = SWP_ACK_FRAME;
+  header.flags = 0;
+  header.seqNum = SWP_LFR;
+  header.length = 0;
+  header.aux = 0;
+  size = SWP_encodeFrame (wire,&header,0,0);
+  SWP_answer (sock,wire,size,toAddr);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_sendSyn
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_sendSyn (void)
+{
+  // send our handshake, and resend it if it isn't answered in time
+  SWP_sendOut (0,SWP_synFrame,SWP_synLength,0,0);
+  SWP_timeoutFromNow (&SWP_synTimeout);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_probe
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_probe (struct timeval *now)
+{
+  // called every tick while probing.  Resend a probe that hasn't been
+  // answered, or give up on it as too big, and start the next one.
+  if (SWP_probeSize)
+    {
+      if (timercmp(now,&SWP_probeTimeout,<))
+	return;
+      if (++SWP_probeTries < SWP_PROBE_TRIES)
+	{
+	  SWP_sendProbe ();
+	  return;
+	}
+      SWP_probeHi = SWP_probeSize - 1;
+      SWP_probeSize = 0;
+    }
+
+  SWP_nextProbe ();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_nextProbe
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_nextProbe (void)
+{
+  // probe halfway between the largest payload known to get through and the
+  // largest that might, until the two meet
+  while (!SWP_probeSize && SWP_probeLo < SWP_probeHi)
+    {
+      SWP_probeSize = (SWP_probeLo + SWP_probeHi + 1) / 2;
+      SWP_probeTries = 0;
+      SWP_probeSeq = SWP_seq (SWP_probeSeq + 1);
+      SWP_sendProbe ();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_sendProbe
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_sendProbe (void)
+{
+  // send the probe for SWP_probeSize.  Called with SIGIO and SIGALRM
+  // blocked.
+  struct SWP_header header;
+  unsigned char wire [SWP_MAX_FRAME];
+  int size;
+
+  header.type = SWP_PROBE_FRAME;
+  header.flags = 0;
+  header.seqNum = SWP_probeSeq;
+  header.length = SWP_probeSize;
+  header.aux = 0;
+  size = SWP_encodeFrame (wire,&header,SWP_probePad,SWP_probeSize);
+
+  if (SWP_paceBurst)
+    SWP_paceTake (size,1);
+  SWP_timeoutFromNow (&SWP_probeTimeout);
+
+  // a probe too big for our own interface doesn't go anywhere
+  if (SWP_sendOut (0,wire,size,0,0) < 0 && errno == EMSGSIZE)
+    {
+      SWP_probeHi = SWP_probeSize - 1;
+      SWP_probeSize = 0;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_acceptProbeAck
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_acceptProbeAck (struct SWP_header *header)
+{
+  // a probe got through, so frames that big may be used from now on
+  if (!SWP_probeSize || header->seqNum != SWP_probeSeq ||
+      header->length != SWP_probeSize)
+    return;
+
+  SWP_probeLo = SWP_payloadSize = SWP_probeSize;
+  SWP_probeSize = 0;
+  SWP_nextProbe ();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_acceptSynAck
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_acceptSynAck (struct SWP_header *header, unsigned char *params)
+{
+  // the receiver has answered our handshake, so switch to the parameters
+  // it agreed to.  Called from SWP_ackSIGIO.
+  struct SWP_resumeToken agreed;
+  struct SWP_header frame;
+  unsigned char payload [SWP_PAYLOAD_SIZE];
+  int seq,slot,offset;
+
+  if (SWP_sessionOpen || header->seqNum != SWP_sessionISN ||
+      SWP_getParams(params,&agreed) < 0 ||
+      agreed.payloadSize > SWP_PAYLOAD_SIZE)
+    return;
+
+  // the payload size can't go over what the receiver agreed to.  When
+  // probing, that's as far as the probes go.
+  if (SWP_payloadSize > agreed.payloadSize)
+    SWP_payloadSize = agreed.payloadSize;
+  if (SWP_probeHi > agreed.payloadSize)
+    SWP_probeHi = agreed.payloadSize;
+  if (SWP_probeLo > SWP_payloadSize)
+    SWP_probeLo = SWP_payloadSize;
+
+  // spread frames over the stripes both ends have from now on
+  SWP_stripesInUse = agreed.stripes;
+  if (SWP_stripesInUse > SWP_numStripes)
+    SWP_stripesInUse = SWP_numStripes;
+
+  // and compress if both ends agreed to.  Frames already sent compressed
+  // under a resumed session are decompressed either way.
+  agreed.compress = (header->flags & SWP_FLAG_COMPRESS) &&
+    SWP_session.compress;
+  SWP_compressing = agreed.compress;
+
+  // small messages are packed together if the receiver takes records
+  SWP_coalescing = SWP_coalesceUsecs &&
+    (header->flags & SWP_FLAG_RECORDS);
+
+  // never use a bigger window than we asked for.  Frames of the first
+  // flight beyond the agreed window wait for acks like any other.
+  if (SWP_SWS > agreed.windowSize)
+    SWP_SWS = agreed.windowSize;
+  SWP_sendSlotsAvail = SWP_SWS - SWP_seq (SWP_LFS - SWP_LAR);
+  SWP_sendWait = (SWP_sendSlotsAvail <= 0);
+
+  // frames waiting for an ack were encoded under the policy we proposed;
+  // encode them again in case they have to be resent
+  if (agreed.checkPolicy != SWP_checkPolicy)
+    {
+      SWP_altPolicy = SWP_checkPolicy;
+      SWP_checkPolicy = agreed.checkPolicy;
+      for (seq=SWP_seq (SWP_LAR+1);
+	   SWP_inWindow(SWP_LAR,SWP_LFS,seq);
+	   seq=SWP_seq (seq+1))
+	{
+	  slot = SWP_slot (seq);
+	  if (SWP_sendData[slot])
+	    {
+	      // only the header is in the buffer
+	      frame.type = SWP_DATA_FRAME;
+	      frame.flags = 0;
+	      frame.seqNum = seq;
+	      frame.length = SWP_sendDataLen[slot];
+	      frame.aux = 0;
+	      SWP_sendLength[slot] = frame.length +
+		SWP_encodeHeader (SWP_sendBuffer[slot],&frame,
+				  SWP_sendData[slot],frame.length);
+	      continue;
+	    }
+	  offset = SWP_decodeFrame (SWP_sendBuffer[slot],SWP_sendLength[slot],
+				    &frame,SWP_altPolicy,-1);
+	  memmove (payload,SWP_sendBuffer[slot]+offset,frame.length);
+	  SWP_sendLength[slot] =
+	    SWP_encodeFrame (SWP_sendBuffer[slot],&frame,payload,frame.length);
+	}
+      SWP_altPolicy = -1;
+    }
+
+  // a block can't be bigger than the window
+  if (SWP_fecK > SWP_SWS)
+    SWP_fecK = SWP_SWS;
+  if (SWP_fecBlockCount > 0 && SWP_fecBlockCount >= SWP_fecK)
+    SWP_fecSendParity ();
+
+  SWP_session = agreed;
+  SWP_resumed = (header->flags & SWP_FLAG_RESUME) != 0;
+  SWP_sessionOpen = 1;
+
+  // start looking for a bigger payload size straight away
+  if (SWP_probing)
+    SWP_nextProbe ();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_decompress
+//
+///////////////////////////////////////////////////////////////////////////////
+int SWP_decompress (unsigned char *payload, int length,
+		    unsigned char *data)
+{
+  // decompress the length byte payload of a frame straight into data, the
+  // frame's place in the receive buffer.  Returns the payload's length
+  // once decompressed, or -1 if it's malformed or bigger than the session
+  // allows.  Called with the lock held.
+  struct timespec start,stop;
+  int size;
+
+  clock_gettime (CLOCK_MONOTONIC,&start);
+  size = LZ_decompress (payload,length,data,SWP_recvPayloadSize);
+  clock_gettime (CLOCK_MONOTONIC,&stop);
+  SWP_decompressNsecs += SWP_elapsed (&start,&stop) * 1000000000;
+  if (size >= 0)
+    {
+      SWP_stats.framesDecompressed++;
+      SWP_stats.bytesBeforeCompression += size;
+      SWP_stats.bytesAfterCompression += length;
+    }
+  return size;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_recordsValid
+//
+///////////////////////////////////////////////////////////////////////////////
+static int SWP_recordsValid (unsigned char *data, int length)
+{
+  // true iff the length byte payload of a frame of records is a series of
+  // records that ends where the payload does, so that SWP_recv can hand
+  // them over without looking again
+  int offset = 0;
+
+  while (offset + SWP_RECORD_HEADER <= length)
+    offset += SWP_RECORD_HEADER + ((data[offset] << 8) | data[offset+1]);
+  return offset == length && length > 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_acceptSyn
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_acceptSyn (int sock, struct SWP_header *header,
+		    unsigned char *params, struct sockaddr_in *fromAddr)
+{
+  // a sender's handshake has arrived on socket sock.  Start a new session
+  // unless it's a resent handshake for the session we have, then answer
+  // it.  A handshake from another sender only gets here once the
+  // session's sender has gone quiet.  Called with the lock held.
+  struct SWP_resumeToken proposed;
+  struct SWP_header reply;
+  unsigned char token [SWP_TOKEN_SIZE];
+  unsigned char wire [SWP_HEADER_SIZE + SWP_MAX_CHECK_SIZE +
+		      SWP_HANDSHAKE_SIZE];
+  unsigned char answer [SWP_HANDSHAKE_SIZE];
+  int size;
+
+  if (SWP_getParams(params,&proposed) < 0)
+    return;
+  proposed.compress = (header->flags & SWP_FLAG_COMPRESS) != 0;
+
+  if (!SWP_recvSessionOpen || SWP_sessionLegacy ||
+      header->seqNum != SWP_recvSessionISN || !SWP_fromPeer(sock,fromAddr))
+    {
+      // the first flight of data was sent under the policy the sender
+      // proposed
+      SWP_recvAltPolicy = proposed.checkPolicy;
+
+      // a good token means we agreed to these parameters before;
+      // otherwise the window and payload are the smaller of what each of
+      // us can take, and the policy is ours
+      SWP_makeToken (&proposed,fromAddr,token);
+      SWP_recvResumed = (header->flags & SWP_FLAG_RESUME) &&
+	!memcmp (token,proposed.token,SWP_TOKEN_SIZE) &&
+	proposed.windowSize <= SWP_maxWindow &&
+	proposed.payloadSize <= SWP_localPayload &&
+	proposed.stripes <= SWP_numStripes &&
+	(!proposed.compress || SWP_localCompress);
+      if (!SWP_recvResumed)
+	{
+	  if (proposed.windowSize > SWP_maxWindow)
+	    proposed.windowSize = SWP_maxWindow;
+	  if (proposed.payloadSize > SWP_localPayload)
+	    proposed.payloadSize = SWP_localPayload;
+	  if (proposed.stripes > SWP_numStripes)
+	    proposed.stripes = SWP_numStripes;
+	  proposed.compress &= SWP_localCompress;
+	  proposed.checkPolicy = SWP_localPolicy;
+	}
+
+      SWP_recvSession = proposed;
+      SWP_makeToken (&SWP_recvSession,fromAddr,SWP_recvSession.token);
+      SWP_recvPolicy = SWP_recvSession.checkPolicy;
+      SWP_recvPayloadSize = SWP_recvSession.payloadSize;
+      SWP_recvPeer = *fromAddr;
+      SWP_sessionLegacy = 0;
+      SWP_openSession (header->seqNum,SWP_SEQ_SPACE,SWP_recvSession.windowSize);
+    }
+  clock_gettime (CLOCK_MONOTONIC,&SWP_recvHeard);
+
+  reply.type = SWP_SYNACK_FRAME;
+  reply.flags = (SWP_recvResumed ? SWP_FLAG_RESUME : 0) |
+    (SWP_recvSession.compress ? SWP_FLAG_COMPRESS : 0) |
+    (header->flags & SWP_FLAG_RECORDS);
+  reply.seqNum = SWP_recvSessionISN;
+  reply.length = SWP_HANDSHAKE_SIZE;
+  reply.aux = 0;
+  SWP_putParams (answer,&SWP_recvSession);
+  size = SWP_encodeFrame (wire,&reply,answer,SWP_HANDSHAKE_SIZE);
+  SWP_answer (sock,wire,size,fromAddr);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_openSession
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_openSession (int isn, int seqSpace, int window)
+{
+  // start receiving a new session whose first frame follows isn.  Frames
+  // of an earlier session already in Q are still delivered.
+  int i;
+
+  SWP_ReceiveSize = seqSpace;
+  SWP_ReceiveMask = (seqSpace & (seqSpace - 1)) ? 0 : seqSpace - 1;
+  SWP_RWS = window;
+
+  // initialize receive window
+  SWP_LFR = isn;
+  SWP_LAF = SWP_recvSeq (isn + window);
+
+  // no frames or parity frames are in the buffer
+  memset (SWP_frameBits,0,sizeof(SWP_frameBits));
+  for (i=0;i<SWP_BUFSIZE;i++)
+    {
+      SWP_parityReceived[i] = 0;
+      SWP_fecBlockOf[i] = -1;
+    }
+
+  SWP_recvSessionISN = isn;
+  SWP_recvSessionOpen = 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_fromPeer
+//
+///////////////////////////////////////////////////////////////////////////////
+int SWP_fromPeer (int sock, struct sockaddr_in *fromAddr)
+{
+  // 1 if a frame that came in on socket sock from fromAddr is from the
+  // sender the session is with.  The sender's other stripes send from
+  // other ports, so on those only the host is compared.
+  if (fromAddr->sin_addr.s_addr != SWP_recvPeer.sin_addr.s_addr)
+    return 0;
+  return (sock != SWP_recvDataSock && sock != SWP_SHM_SOCK) ||
+    fromAddr->sin_port == SWP_recvPeer.sin_port;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_peerBusy
+//
+///////////////////////////////////////////////////////////////////////////////
+int SWP_peerBusy (int sock, struct sockaddr_in *fromAddr)
+{
+  // 1 if a frame that came in on socket sock from fromAddr is from another
+  // sender than the session's, and the session's has been heard from in
+  // the last SWP_PEER_IDLE_SECS seconds.  Called with the lock held.
+  struct timespec now;
+
+  if (!SWP_recvSessionOpen || SWP_fromPeer(sock,fromAddr))
+    return 0;
+  clock_gettime (CLOCK_MONOTONIC,&now);
+  return SWP_elapsed (&SWP_recvHeard,&now) < SWP_PEER_IDLE_SECS;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_putParams
+//
+///////////////////////////////////////////////////////////////////////////////
+static void SWP_putParams (unsigned char *wire,
+			   struct SWP_resumeToken *params)
+{
+  // encode session parameters as the payload of a handshake frame
+  wire[0] = params->windowSize >> 8;
+  wire[1] = params->windowSize & 0xff;
+  wire[2] = params->payloadSize >> 8;
+  wire[3] = params->payloadSize & 0xff;
+  wire[4] = params->checkPolicy;
+  wire[5] = params->stripes;
+  memcpy (wire+6,params->token,SWP_TOKEN_SIZE);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_getParams
+//
+///////////////////////////////////////////////////////////////////////////////
+static int SWP_getParams (unsigned char *wire,
+			  struct SWP_resumeToken *params)
+{
+  // decode the session parameters of a handshake frame.  Returns -1 if
+  // they make no sense.
+  params->windowSize = (wire[0] << 8) | wire[1];
+  params->payloadSize = (wire[2] << 8) | wire[3];
+  params->checkPolicy = wire[4];
+  params->stripes = wire[5] ? wire[5] : 1;
+  params->compress = 0;
+  memcpy (params->token,wire+6,SWP_TOKEN_SIZE);
+
+  if (params->windowSize<1 || params->windowSize>SWP_WINDOW_LIMIT ||
+      params->payloadSize<1 || CK_size(params->checkPolicy) < 0 ||
+      params->stripes>SWP_MAX_STRIPES)
+    return -1;
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_makeToken
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_makeToken (struct SWP_resumeToken *params,
+		    struct sockaddr_in *peer, unsigned char *token)
+{
+  // a resumption token is a keyed hash of the session parameters,
+  // compression included, and the peer's address.  It isn't meant to
+  // stand up to an attacker, only to keep a peer from resuming with
+  // parameters we never agreed to.
+  struct CK_state st;
+  unsigned char wire [SWP_HANDSHAKE_SIZE];
+  unsigned char key [8];
+  unsigned long long hash;
+  int i;
+
+  for (i=0;i<8;i++)
+    key[i] = SWP_tokenKey >> (8 * i);
+  SWP_putParams (wire,params);
+
+  CK_begin (&st,CK_HASH64);
+  CK_update (&st,key,sizeof(key));
+  CK_update (&st,(unsigned char *)&peer->sin_addr,sizeof(peer->sin_addr));
+  CK_update (&st,wire,6);
+  wire[0] = params->compress;
+  CK_update (&st,wire,1);
+  hash = CK_end (&st);
+
+  for (i=SWP_TOKEN_SIZE-1;i>=0;i--)
+    {
+      token[i] = hash & 0xff;
+      hash >>= 8;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_deliver
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_deliver (void)
+{
+  // move the run of frames that are next in order from the receive buffer
+  // to Q, sliding the receive window along past all of them at once.  A
+  // run stops at a missing frame, when Q is full, or where the sequence
+  // numbers wrap, since a legacy sequence space doesn't wrap with the
+  // buffer slots.
+  struct SWP_dataMsg *frame;
+  int first,run,max,seq,i;
+
+  while (1)
+    {
+      first = SWP_recvSeq (SWP_LFR + 1);
+      max = Q_DATASIZE - Q.size;
+      if (max > SWP_ReceiveSize - first)
+	max = SWP_ReceiveSize - first;
+      run = SWP_frameRun (SWP_slot (first),max);
+      if (run == 0)
+	break;
+
+      // copy only as much of each frame as is used; it may be much
+      // smaller than the biggest payload
+      for (i=0,seq=first;i<run;i++,seq++)
+	{
+	  frame = &SWP_receiveBuffer[SWP_slot (seq)];
+	  Q.data[Q.rear].seqNum = frame->seqNum;
+	  Q.data[Q.rear].records = frame->records;
+	  Q.data[Q.rear].length = frame->length;
+	  memmove (Q.data[Q.rear].data,frame->data,frame->length);
+	  Q.rear = (Q.rear + 1) & (Q_DATASIZE - 1);
+	  SWP_fecRelease (seq);
+	}
+      Q.size += run;
+
+      SWP_clearFrames (SWP_slot (first),run);
+      SWP_LFR = SWP_recvSeq (SWP_LFR + run);
+      SWP_LAF = SWP_recvSeq (SWP_LAF + run);
+    }
+
+  SWP_recvWait = (Q.size==0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_frameRun
+//
+///////////////////////////////////////////////////////////////////////////////
+int SWP_frameRun (int slot, int max)
+{
+  // returns the number of frames present in a row from slot on, up to max.
+  // The trailing ones of each word are counted in one step.
+  uint64_t missing;
+  int run = 0;
+  int bit,n;
+
+  while (run < max)
+    {
+      // the bits shifted in from the top count as missing, so a run that
+      // goes on into the next word stops at the end of this one
+      bit = slot & 63;
+      missing = ~(SWP_frameBits[slot >> 6] >> bit);
+      n = missing ? __builtin_ctzll (missing) : 64;
+      run += n;
+      if (n < 64 - bit)
+	break;
+      slot = (slot + n) & (SWP_BUFSIZE - 1);
+    }
+
+  return run < max ? run : max;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_clearFrames
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_clearFrames (int slot, int count)
+{
+  // clear count bits of the reorder buffer from slot on, a word at a time
+  uint64_t mask;
+  int bit,n;
+
+  while (count > 0)
+    {
+      bit = slot & 63;
+      n = 64 - bit < count ? 64 - bit : count;
+      mask = (n == 64 ? ~0ULL : (1ULL << n) - 1) << bit;
+      SWP_frameBits[slot >> 6] &= ~mask;
+      slot = (slot + n) & (SWP_BUFSIZE - 1);
+      count -= n;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_startStripes
+//
+///////////////////////////////////////////////////////////////////////////////
+int SWP_startStripes (void *(Swp::*serve)(void *))
+{
+  // start a thread running serve for each stripe but stripe 0
+  long i;
+
+  for (i=1;i<SWP_numStripes;i++)
+    if (SWP_spawn (serve,i) < 0)
+      {
+	printf ("Can't start a thread for stripe %ld\n",i);
+	return -1;
+      }
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_startThread
+//
+///////////////////////////////////////////////////////////////////////////////
+int SWP_startThread (void *(Swp::*serve)(void *), const char *what)
+{
+  // start a thread of ours running serve, for what what names
+  if (SWP_spawn (serve,0) < 0)
+    {
+      printf ("Can't start the thread for %s\n",what);
+      return -1;
+    }
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_spawn
+//
+///////////////////////////////////////////////////////////////////////////////
+int SWP_spawn (void *(Swp::*serve)(void *), long arg)
+{
+  // start a thread running serve on this engine, passing it arg.  The
+  // thread starts with every signal blocked, so that the handlers never
+  // run on it.
+  struct SWP_thread *thread;
+  sigset_t oldsigset,sigset;
+  int err;
+
+  if (SWP_numThreads == SWP_MAX_THREADS)
+    return -1;
+  thread = &SWP_threads[SWP_numThreads];
+  thread->engine = this;
+  thread->serve = serve;
+  thread->arg = arg;
+
+  sigfillset (&sigset);
+  pthread_sigmask (SIG_BLOCK,&sigset,&oldsigset);
+  err = pthread_create (&thread->thread,0,SWP_runThread,thread);
+  pthread_sigmask (SIG_SETMASK,&oldsigset,0);
+  if (err != 0)
+    return -1;
+  SWP_numThreads++;
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_runThread
+//
+///////////////////////////////////////////////////////////////////////////////
+static void *SWP_runThread (void *arg)
+{
+  // what a thread started by SWP_spawn runs
+  struct SWP_thread *thread = (struct SWP_thread *)arg;
+
+  return (thread->engine->*thread->serve) ((void *)thread->arg);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_isLocal
+//
+///////////////////////////////////////////////////////////////////////////////
+static int SWP_isLocal (struct sockaddr_in *addr)
+{
+  // true iff addr is an address of this host, which is so iff a socket
+  // can be bound to it
+  struct sockaddr_in local;
+  int sock,ok;
+
+  if ((sock = socket(PF_INET,SOCK_DGRAM,IPPROTO_UDP)) < 0)
+    return 0;
+  local = *addr;
+  local.sin_port = 0;
+  ok = bind (sock,(struct sockaddr *)&local,sizeof(local)) == 0;
+  close (sock);
+  return ok;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_exiting
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_exiting (void)
+{
+  // collect the last of the kernel's stamps for the trace, and take down
+  // the name of our shared memory channel, as the process exits.  Called
+  // with the handlers kept out.
+  int i;
+
+  if (SWP_traceSent)
+    for (i=0;i<SWP_stripesInUse;i++)
+      SWP_traceDrain (i);
+  if (SWP_recvShm)
+    SHM_remove (SWP_recvShm);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_lock
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_lock (sigset_t *oldsigset)
+{
+  // take the lock on the protocol state: block the signals whose handlers
+  // use the state, then keep the other threads out
+  SWP_blockSignals (oldsigset);
+  pthread_mutex_lock (&SWP_mutex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_unlock
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_unlock (sigset_t *oldsigset)
+{
+  SWP_ringSubmit ();
+  pthread_mutex_unlock (&SWP_mutex);
+  pthread_sigmask (SIG_SETMASK,oldsigset,0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_wait
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_wait (sigset_t *oldsigset)
+{
+  // let go of the lock and wait for a signal, then take the lock again.
+  // A thread that changes the state while we wait sends us SIGIO; since
+  // SIGIO stays blocked until sigsuspend, it can't be missed.
+  sigset_t sigset;
+  struct timespec poll;
+  pthread_t self;
+  int i;
+
+  // what we've sent must go before we sleep
+  SWP_ringSubmit ();
+
+  self = pthread_self ();
+  if (SWP_numWaiters == SWP_MAX_WAITERS)
+    {
+      pthread_mutex_unlock (&SWP_mutex);
+      poll.tv_sec = 0;
+      poll.tv_nsec = 1000000;
+      nanosleep (&poll,0);
+      pthread_mutex_lock (&SWP_mutex);
+      return;
+    }
+  SWP_waiter[SWP_numWaiters++] = self;
+
+  sigset = *oldsigset;
+  sigdelset (&sigset,SIGIO);
+  pthread_mutex_unlock (&SWP_mutex);
+  sigsuspend (&sigset);
+  pthread_mutex_lock (&SWP_mutex);
+
+  // we're still on the list if something else woke us
+  for (i=0;i<SWP_numWaiters;i++)
+    if (pthread_equal (SWP_waiter[i],self))
+      {
+	SWP_waiter[i] = SWP_waiter[--SWP_numWaiters];
+	break;
+      }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_wake
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_wake (void)
+{
+  // called with the lock held after changing what other threads may be
+  // waiting for.  Wakes them all; a thread is never sent SIGIO by itself,
+  // since it isn't waiting.
+  pthread_t self;
+  int i,n;
+
+  self = pthread_self ();
+  for (i=n=0;i<SWP_numWaiters;i++)
+    if (pthread_equal (SWP_waiter[i],self))
+      SWP_waiter[n++] = self;
+    else
+      pthread_kill (SWP_waiter[i],SIGIO);
+  SWP_numWaiters = n;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_recvStamped
+//
+///////////////////////////////////////////////////////////////////////////////
+int SWP_recvStamped (int sock, unsigned char *buf, int size,
+		     struct sockaddr_in *fromAddr, long long *stamp)
+{
+  // receive a datagram on sock, as recvfrom would, from fromAddr unless
+  // it's null.  When tracing, stamp is set to the time the kernel took the
+  // datagram in, or 0 if it didn't say.
+  union {
+    char buf [256];
+    struct cmsghdr align;
+  } control;
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  int n;
+
+  iov.iov_base = buf;
+  iov.iov_len = size;
+  memset (&msg,0,sizeof(msg));
+  msg.msg_name = fromAddr;
+  msg.msg_namelen = fromAddr ? sizeof(*fromAddr) : 0;
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  if (SWP_tracing)
+    {
+      msg.msg_control = control.buf;
+      msg.msg_controllen = sizeof(control.buf);
+    }
+
+  *stamp = 0;
+  n = recvmsg (sock,&msg,0);
+#ifdef SO_TIMESTAMPING
+  for (cmsg=CMSG_FIRSTHDR(&msg);n>=0 && cmsg;cmsg=CMSG_NXTHDR(&msg,cmsg))
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPING)
+      {
+	struct scm_timestamping *ts =
+	  (struct scm_timestamping *)CMSG_DATA(cmsg);
+	*stamp = ts->ts[0].tv_sec * 1000000000LL + ts->ts[0].tv_nsec;
+      }
+#endif
+  return n;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_traceSocket
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_traceSocket (int sock, int sent)
+{
+  // ask the kernel to stamp datagrams as they come in on sock and, if sent
+  // is set, as they leave.  Without the stamps, events are timed when we
+  // see them.
+#ifdef SO_TIMESTAMPING
+  int flags;
+
+  flags = SOF_TIMESTAMPING_SOFTWARE | SOF_TIMESTAMPING_RX_SOFTWARE;
+  if (sent)
+    flags |= SOF_TIMESTAMPING_TX_SOFTWARE;
+  if (setsockopt (sock,SOL_SOCKET,SO_TIMESTAMPING,&flags,sizeof(flags)) == 0
+      && sent)
+    SWP_traceSent = 1;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_traceDrain
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_traceDrain (int stripe)
+{
+  // record the stamps the kernel has put on the given stripe's error
+  // queue for frames that left it.  Each comes back with the frame itself,
+  // behind its link, IP and UDP headers.
+#ifdef SO_TIMESTAMPING
+  union {
+    char buf [256];
+    struct cmsghdr align;
+  } control;
+  unsigned char packet [SWP_MAX_FRAME + 128];
+  struct scm_timestamping *ts;
+  struct SWP_header header;
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  long long stamp;
+  int n,ip,frame;
+
+  while (1)
+    {
+      iov.iov_base = packet;
+      iov.iov_len = sizeof(packet);
+      memset (&msg,0,sizeof(msg));
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+      msg.msg_control = control.buf;
+      msg.msg_controllen = sizeof(control.buf);
+      if ((n = recvmsg (SWP_stripeSock[stripe],&msg,
+			MSG_ERRQUEUE|MSG_DONTWAIT)) < 0)
+	break;
+
+      stamp = 0;
+      for (cmsg=CMSG_FIRSTHDR(&msg);cmsg;cmsg=CMSG_NXTHDR(&msg,cmsg))
+	if (cmsg->cmsg_level == SOL_SOCKET &&
+	    cmsg->cmsg_type == SCM_TIMESTAMPING)
+	  {
+	    ts = (struct scm_timestamping *)CMSG_DATA(cmsg);
+	    stamp = ts->ts[0].tv_sec * 1000000000LL + ts->ts[0].tv_nsec;
+	  }
+      if (stamp == 0 || (msg.msg_flags & MSG_TRUNC))
+	continue;
+
+      // the IP header is the one whose total length runs to the end of the
+      // packet; the link header in front of it may be empty, Ethernet, or
+      // Ethernet with a VLAN tag
+      for (ip=0;ip<=18;ip+=(ip ? 4 : 14))
+	if (ip + 20 <= n && packet[ip] >> 4 == 4 &&
+	    ((packet[ip+2] << 8) | packet[ip+3]) == n - ip)
+	  break;
+      if (ip > 18)
+	continue;
+      frame = ip + (packet[ip] & 0x0f) * 4 + 8;
+
+      // frames garbled on the way out no longer pass their check
+      if (frame < n &&
+	  SWP_decodeFrame (packet+frame,n-frame,&header,
+			   SWP_checkPolicy,SWP_altPolicy) >= 0 &&
+	  header.type == SWP_DATA_FRAME)
+	TR_record (TR_TX_KERNEL,header.seqNum,stripe,header.length,stamp,1);
+    }
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_paceFill
+//
+///////////////////////////////////////////////////////////////////////////////
+double SWP_paceFill (void)
+{
+  // add the tokens earned since the bucket was last filled and return the
+  // pacing rate, which is 0 if there's no rate to pace at yet
+  struct timespec now;
+  double rate = SWP_paceRate;
+  double depth = SWP_paceBurst * SWP_frameSize ();
+
+  if (rate == 0 && SWP_srtt > 0)
+    rate = SWP_SWS * SWP_frameSize () / SWP_srtt;
+
+  clock_gettime (CLOCK_MONOTONIC,&now);
+  SWP_paceTokens += rate * SWP_elapsed(&SWP_paceLast,&now);
+  if (SWP_paceTokens > depth)
+    SWP_paceTokens = depth;
+  SWP_paceLast = now;
+
+  return rate;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_paceWait
+//
+///////////////////////////////////////////////////////////////////////////////
+int SWP_paceWait (int bytes, sigset_t *oldsigset)
+{
+  // take bytes tokens from the bucket and return true if it holds them.
+  // Otherwise sleep until enough will have come in, or a signal wakes us,
+  // and return false.  Called with the lock held, since resent frames
+  // take tokens from the bucket too; the lock is let go while we sleep.
+  struct timespec delay;
+  double rate,wait;
+
+  if ((rate = SWP_paceFill()) <= 0 || SWP_paceTokens >= bytes)
+    {
+      SWP_paceTokens -= bytes;
+      return 1;
+    }
+
+  wait = (bytes - SWP_paceTokens) / rate;
+  delay.tv_sec = (time_t)wait;
+  delay.tv_nsec = (wait - delay.tv_sec) * 1000000000;
+  SWP_unlock (oldsigset);
+  nanosleep (&delay,0);
+  SWP_lock (0);
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_paceTake
+//
+///////////////////////////////////////////////////////////////////////////////
+int SWP_paceTake (int bytes, int mustSend)
+{
+  // take bytes tokens for a frame sent from a signal handler, where we
+  // can't wait.  The bucket may go into debt by up to its depth, which
+  // holds back new frames in SWP_paceWait; beyond that the frame must wait
+  // unless mustSend is set.  Returns true iff the frame may be sent.
+  double depth = SWP_paceBurst * SWP_frameSize ();
+
+  if (SWP_paceFill() > 0 && !mustSend && SWP_paceTokens + depth < bytes)
+    return 0;
+
+  SWP_paceTokens -= bytes;
+  if (SWP_paceTokens < -depth)
+    SWP_paceTokens = -depth;
+  return 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_rttSample
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_rttSample (int seqNum)
+{
+  // fold the round trip time of frame seqNum into the smoothed estimate
+  struct timespec now;
+  double sample;
+
+  clock_gettime (CLOCK_MONOTONIC,&now);
+  sample = SWP_elapsed (&SWP_sendTime[SWP_slot (seqNum)],&now);
+  if (SWP_srtt == 0)
+    SWP_srtt = sample;
+  else
+    SWP_srtt = 0.875 * SWP_srtt + 0.125 * sample;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_elapsed
+//
+///////////////////////////////////////////////////////////////////////////////
+static double SWP_elapsed (struct timespec *from, struct timespec *to)
+{
+  // seconds from from to to
+  return (to->tv_sec - from->tv_sec) +
+    (to->tv_nsec - from->tv_nsec) * 0.000000001;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_encodeFrame
+//
+///////////////////////////////////////////////////////////////////////////////
+int SWP_encodeFrame (unsigned char *wire, struct SWP_header *header,
+		     const void *payload, int payloadSize)
+{
+  // encode a frame with the given header and payloadSize byte payload into
+  // wire, under our integrity policy, and return its size in bytes
+  int size;
+
+  size = SWP_encodeHeader (wire,header,payload,payloadSize);
+  if (payloadSize > 0)
+    memcpy (wire+size,payload,payloadSize);
+  return size + payloadSize;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_encodeHeader
+//
+///////////////////////////////////////////////////////////////////////////////
+int SWP_encodeHeader (unsigned char *wire, struct SWP_header *header,
+		      const void *payload, int payloadSize)
+{
+  // encode the header of a frame, and the check value over the header and
+  // the payloadSize byte payload, into wire, under the policy of the
+  // session the frame belongs to: acks are the receiver's.  The payload
+  // itself isn't copied, and may be sent from where it is.  Returns the
+  // number of bytes before the payload.
+  unsigned long long check;
+  int policy,checkSize;
+  int i;
+
+  if (header->type == SWP_SYN_FRAME || header->type == SWP_SYNACK_FRAME)
+    policy = SWP_HANDSHAKE_CHECK;
+  else if (header->type == SWP_ACK_FRAME ||
+	   header->type == SWP_PROBEACK_FRAME)
+    policy = SWP_recvPolicy;
+  else
+    policy = SWP_checkPolicy;
+  checkSize = SWP_checkSize (policy);
+
+  wire[SWP_OFF_VERTYPE] = (SWP_VERSION << 4) | header->type;
+  wire[SWP_OFF_FLAGS] = policy | (header->flags & ~SWP_FLAG_CHECK_MASK);
+  wire[SWP_OFF_SEQNUM] = header->seqNum >> 8;
+  wire[SWP_OFF_SEQNUM+1] = header->seqNum & 0xff;
+  wire[SWP_OFF_LENGTH] = header->length >> 8;
+  wire[SWP_OFF_LENGTH+1] = header->length & 0xff;
+  wire[SWP_OFF_AUX] = header->aux >> 8;
+  wire[SWP_OFF_AUX+1] = header->aux & 0xff;
+
+  // the check value goes between the header and the payload, most
+  // significant byte first
+  if (checkSize > 0)
+    {
+      check = SWP_checkValue (policy,wire,
+			      (const unsigned char *)payload,payloadSize);
+      for (i=checkSize-1;i>=0;i--)
+	{
+	  wire[SWP_OFF_CHECK+i] = check & 0xff;
+	  check >>= 8;
+	}
+    }
+
+  return SWP_HEADER_SIZE + checkSize;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_decodeFrame
+//
+///////////////////////////////////////////////////////////////////////////////
+static int SWP_decodeFrame (unsigned char *wire, int size,
+			    struct SWP_header *header, int policy,
+			    int altPolicy)
+{
+  // decode the size byte frame in wire into header.  Returns the offset of
+  // the payload, or -1 if the frame isn't one of ours, wasn't sent under
+  // integrity policy policy or altPolicy (handshakes under
+  // SWP_HANDSHAKE_CHECK), is the wrong size or fails its check.
+  unsigned long long check;
+  int checkSize;
+  int payloadSize;
+  int i;
+
+  if (size < SWP_HEADER_SIZE || wire[SWP_OFF_VERTYPE] >> 4 != SWP_VERSION)
+    return -1;
+
+  header->type = wire[SWP_OFF_VERTYPE] & 0x0f;
+  header->flags = wire[SWP_OFF_FLAGS];
+  header->seqNum = (wire[SWP_OFF_SEQNUM] << 8) | wire[SWP_OFF_SEQNUM+1];
+  header->length = (wire[SWP_OFF_LENGTH] << 8) | wire[SWP_OFF_LENGTH+1];
+  header->aux = (wire[SWP_OFF_AUX] << 8) | wire[SWP_OFF_AUX+1];
+
+  if (header->type == SWP_SYN_FRAME || header->type == SWP_SYNACK_FRAME)
+    policy = altPolicy = SWP_HANDSHAKE_CHECK;
+  if ((header->flags & SWP_FLAG_CHECK_MASK) != policy &&
+      (header->flags & SWP_FLAG_CHECK_MASK) != altPolicy)
+    return -1;
+  policy = header->flags & SWP_FLAG_CHECK_MASK;
+  checkSize = SWP_checkSize (policy);
+
+  // a parity frame's length field is the parity of its block's lengths,
+  // and its payload is whatever follows the check value
+  switch (header->type)
+    {
+    case SWP_DATA_FRAME:
+    case SWP_PROBE_FRAME:
+      if (header->length > SWP_PAYLOAD_SIZE)
+	return -1;
+      payloadSize = header->length;
+      break;
+    case SWP_PARITY_FRAME:
+      payloadSize = size - SWP_HEADER_SIZE - checkSize;
+      if (payloadSize < 0 || payloadSize > SWP_PAYLOAD_SIZE)
+	return -1;
+      break;
+    case SWP_ACK_FRAME:
+    case SWP_PROBEACK_FRAME:
+      payloadSize = 0;
+      break;
+    case SWP_SYN_FRAME:
+    case SWP_SYNACK_FRAME:
+      if (header->length != SWP_HANDSHAKE_SIZE)
+	return -1;
+      payloadSize = SWP_HANDSHAKE_SIZE;
+      break;
+    default:
+      return -1;
+    }
+  if (size != SWP_HEADER_SIZE + checkSize + payloadSize)
+    return -1;
+
+  if (checkSize > 0)
+    {
+      check = SWP_checkValue (policy,wire,wire+SWP_OFF_CHECK+checkSize,
+			      payloadSize);
+      for (i=checkSize-1;i>=0;i--)
+	{
+	  if (wire[SWP_OFF_CHECK+i] != (check & 0xff))
+	    return -1;
+	  check >>= 8;
+	}
+    }
+
+  return SWP_OFF_CHECK + checkSize;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_checkSize
+//
+///////////////////////////////////////////////////////////////////////////////
+static int SWP_checkSize (int policy)
+{
+  // the size of a check value under integrity policy policy, as CK_size.
+  // The engine's own policy's is known when it's compiled.
+  if (policy == ChecksumPolicy::policy)
+    return ChecksumPolicy::size;
+  return CK_size (policy);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_checkValue
+//
+///////////////////////////////////////////////////////////////////////////////
+static unsigned long long SWP_checkValue (int policy,
+					  const unsigned char *header,
+					  const unsigned char *payload,
+					  int payloadSize)
+{
+  // the check value under integrity policy policy of a frame's header and
+  // its payloadSize byte payload.  The engine's own policy's check is
+  // called directly; another policy, which a peer may have settled on, is
+  // computed by CK_update.
+  struct CK_state st;
+
+  if (policy == ChecksumPolicy::policy)
+    return ChecksumPolicy::check (header,SWP_HEADER_SIZE,payload,payloadSize);
+  CK_begin (&st,policy);
+  CK_update (&st,header,SWP_HEADER_SIZE);
+  CK_update (&st,payload,payloadSize);
+  return CK_end (&st);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_decodeLegacy
+//
+///////////////////////////////////////////////////////////////////////////////
+static int SWP_decodeLegacy (unsigned char *wire, int size,
+			     struct SWP_header *header)
+{
+  // as SWP_decodeFrame, for a frame in the layout used before the wire
+  // format was versioned
+  int length;
+
+  // the crc of a good frame, crc included, is zero
+  if ((size != sizeof(struct SWP_legacyDataMsg) &&
+       size != sizeof(struct SWP_legacyAckMsg)) ||
+      calcCRC(wire,size) != 0)
+    return -1;
+
+  header->flags = CK_CRC16;
+  header->seqNum = wire[offsetof(struct SWP_legacyDataMsg,seqNum)];
+  header->aux = 0;
+
+  if (size == sizeof(struct SWP_legacyAckMsg))
+    {
+      header->type = SWP_ACK_FRAME;
+      header->length = 0;
+      return size;
+    }
+
+  memcpy (&length,wire+offsetof(struct SWP_legacyDataMsg,length),
+	  sizeof(length));
+  if (length < 0 || length > SWP_LEGACY_PAYLOAD_SIZE ||
+      length > SWP_PAYLOAD_SIZE)
+    return -1;
+  header->type = SWP_DATA_FRAME;
+  header->length = length;
+  return offsetof(struct SWP_legacyDataMsg,data);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_fecAdd
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_fecAdd (int seqNum, const unsigned char *data, int length,
+		 int records)
+{
+  // add a newly sent frame, of records if records, to the parity of the
+  // current block, and send the parity frames if the block is now complete
+  unsigned char lengthBytes[2];
+  unsigned char coef;
+  int j;
+
+  // the parity vectors are cleared only as far as the longest frame so far
+  if (SWP_fecBlockCount == 0)
+    {
+      SWP_fecBlockStart = seqNum;
+      SWP_fecBlockMax = 0;
+      for (j=0;j<SWP_fecM;j++)
+	memset (SWP_fecParity[j],0,2);
+    }
+  if (length > SWP_fecBlockMax)
+    {
+      for (j=0;j<SWP_fecM;j++)
+	memset (SWP_fecParity[j]+2+SWP_fecBlockMax,0,length-SWP_fecBlockMax);
+      SWP_fecBlockMax = length;
+    }
+
+  lengthBytes[0] = length & 0xff;
+  lengthBytes[1] = (length | (records ? SWP_FEC_RECORDS : 0)) >> 8;
+  for (j=0;j<SWP_fecM;j++)
+    {
+      coef = FEC_coef (j,SWP_fecBlockCount);
+      FEC_addScaled (SWP_fecParity[j],lengthBytes,2,coef);
+      FEC_addScaled (SWP_fecParity[j]+2,data,length,coef);
+    }
+
+  if (++SWP_fecBlockCount >= SWP_fecK)
+    SWP_fecSendParity ();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_fecSendParity
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_fecSendParity (void)
+{
+  // send the parity frames of the current block.  Called with SIGIO and
+  // SIGALRM blocked.
+  struct SWP_header header;
+  unsigned char wire [SWP_MAX_FRAME];
+  int size;
+  int j;
+
+  for (j=0;j<SWP_fecM;j++)
+    {
+      header.type = SWP_PARITY_FRAME;
+      header.flags = 0;
+      header.seqNum = SWP_fecBlockStart;
+      header.length = SWP_fecParity[j][0] | (SWP_fecParity[j][1] << 8);
+      header.aux = (j << 8) | SWP_fecBlockCount;
+      size = SWP_encodeFrame (wire,&header,SWP_fecParity[j]+2,SWP_fecBlockMax);
+
+      // parity frames go out with their block, but still count against
+      // the bucket
+      if (SWP_paceBurst)
+	SWP_paceTake (size,1);
+
+      SWP_sendOut (0,wire,size,0,0);
+      SWP_stats.parityFramesSent++;
+    }
+
+  SWP_fecBlockCount = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_fecStore
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_fecStore (const struct SWP_header *header,
+		   const unsigned char *payload, int payloadSize)
+{
+  // keep a parity frame that arrived and try to rebuild its block.  The
+  // header's aux field holds the parity frame's index in the block and
+  // the number of frames in the block.
+  struct SWP_parityMsg *parity;
+  int blockStart = header->seqNum;
+  int fecIndex = header->aux >> 8;
+  int fecCount = header->aux & 0xff;
+  int lastFrame;
+  int i;
+
+  if (blockStart >= SWP_ReceiveSize || fecCount < 1 ||
+      fecCount > SWP_RWS || fecIndex >= FEC_MAX_PARITY)
+    return;
+
+  // nothing to do if the whole block has already been delivered, i.e. its
+  // last frame is behind the window
+  lastFrame = SWP_recvSeq (blockStart + fecCount - 1);
+  if (!SWP_inWindow(SWP_LFR,SWP_LAF,lastFrame))
+    return;
+
+  if (SWP_parityReceived[SWP_slot (blockStart)] & (1 << fecIndex))
+    return;
+  if (!SWP_parityBuffer &&
+      !(SWP_parityBuffer = (struct SWP_parityMsg (*)[FEC_MAX_PARITY])
+	malloc (SWP_BUFSIZE * sizeof(*SWP_parityBuffer))))
+    return;
+  parity = &SWP_parityBuffer[SWP_slot (blockStart)][fecIndex];
+  parity->fecCount = fecCount;
+  parity->fecSize = payloadSize;
+  parity->length = header->length;
+  memcpy (parity->data,payload,payloadSize);
+  SWP_parityReceived[SWP_slot (blockStart)] |= 1 << fecIndex;
+  for (i=0;i<fecCount;i++)
+    SWP_fecBlockOf[SWP_slot (blockStart + i)] = blockStart;
+
+  SWP_fecRecover (blockStart);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_fecRecover
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_fecRecover (int blockStart)
+{
+  // rebuild the missing frames of a block if we hold at least as many of
+  // its parity frames as there are frames missing
+  struct SWP_dataMsg *frame;
+  unsigned char *syndromes [FEC_MAX_PARITY];
+  unsigned char lengthBytes[2];
+  unsigned char coef;
+  int missing [FEC_MAX_PARITY];
+  int parityIndex [FEC_MAX_PARITY];
+  int numMissing = 0, numParity = 0;
+  int blockSize = 0;
+  int i,j,r,seq,length,records;
+  int held = SWP_parityReceived[SWP_slot (blockStart)];
+  struct SWP_parityMsg *parity = SWP_parityBuffer[SWP_slot (blockStart)];
+  int vecSize = 0;
+
+  for (j=0;j<FEC_MAX_PARITY;j++)
+    if (held & (1 << j))
+      {
+	blockSize = parity[j].fecCount;
+	vecSize = parity[j].fecSize + 2;
+      }
+  if (blockSize == 0)
+    return;
+
+  // frames in the window that haven't arrived are missing; frames behind
+  // the window have been delivered but are still in the receive buffer
+  for (i=0;i<blockSize;i++)
+    {
+      seq = SWP_recvSeq (blockStart + i);
+      if (SWP_inWindow(SWP_LFR,SWP_LAF,seq) &&
+	  !SWP_haveFrame (SWP_slot (seq)))
+	{
+	  if (numMissing == FEC_MAX_PARITY)
+	    return;
+	  missing[numMissing++] = i;
+	}
+    }
+  if (numMissing == 0)
+    return;
+
+  // start each syndrome from a parity frame
+  for (j=0;j<FEC_MAX_PARITY && numParity<numMissing;j++)
+    {
+      if (!(held & (1 << j)))
+	continue;
+      syndromes[numParity] = SWP_fecSyndrome[numParity];
+      syndromes[numParity][0] = parity[j].length & 0xff;
+      syndromes[numParity][1] = (parity[j].length >> 8) & 0xff;
+      if (parity[j].fecSize + 2 != vecSize)
+	return;
+      memmove (syndromes[numParity]+2,parity[j].data,parity[j].fecSize);
+      parityIndex[numParity++] = j;
+    }
+  if (numParity < numMissing)
+    return;
+
+  // subtract out the frames we have
+  for (i=0,r=0;i<blockSize;i++)
+    {
+      if (r < numMissing && missing[r] == i)
+	{
+	  r++;
+	  continue;
+	}
+      frame = &SWP_receiveBuffer[SWP_slot (blockStart + i)];
+      if (frame->length + 2 > vecSize)
+	return;
+      lengthBytes[0] = frame->length & 0xff;
+      lengthBytes[1] = (frame->length |
+			(frame->records ? SWP_FEC_RECORDS : 0)) >> 8;
+      for (j=0;j<numMissing;j++)
+	{
+	  coef = FEC_coef (parityIndex[j],i);
+	  FEC_addScaled (syndromes[j],lengthBytes,2,coef);
+	  FEC_addScaled (syndromes[j]+2,frame->data,frame->length,coef);
+	}
+    }
+
+  if (FEC_solve (numMissing,missing,parityIndex,syndromes,vecSize) < 0)
+    return;
+
+  // put the rebuilt frames in the receive buffer as if they had arrived
+  for (r=0;r<numMissing;r++)
+    {
+      length = syndromes[r][0] | (syndromes[r][1] << 8);
+      records = (length & SWP_FEC_RECORDS) != 0;
+      length &= ~SWP_FEC_RECORDS;
+      if (length + 2 > vecSize ||
+	  (records && !SWP_recordsValid (syndromes[r]+2,length)))
+	continue;
+      seq = SWP_recvSeq (blockStart + missing[r]);
+      frame = &SWP_receiveBuffer[SWP_slot (seq)];
+      frame->seqNum = seq;
+      frame->type = SWP_DATA_FRAME;
+      frame->records = records;
+      frame->length = length;
+      memmove (frame->data,syndromes[r]+2,length);
+      SWP_markFrame (SWP_slot (seq));
+      SWP_stats.framesRecoveredFEC++;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_fecRelease
+//
+///////////////////////////////////////////////////////////////////////////////
+void SWP_fecRelease (int seqNum)
+{
+  // a frame has been delivered.  Once the last frame of a block has gone,
+  // its parity frames are no longer needed.
+  int blockStart = SWP_fecBlockOf[SWP_slot (seqNum)];
+  int slot;
+  int j;
+
+  if (blockStart < 0)
+    return;
+  SWP_fecBlockOf[SWP_slot (seqNum)] = -1;
+
+  slot = SWP_slot (blockStart);
+  for (j=0;j<FEC_MAX_PARITY;j++)
+    if ((SWP_parityReceived[slot] & (1 << j)) &&
+	SWP_recvSeq (blockStart + SWP_parityBuffer[slot][j].fecCount - 1) ==
+	seqNum)
+      {
+	SWP_parityReceived[slot] = 0;
+	break;
+      }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SWP_inWindow
+//
+///////////////////////////////////////////////////////////////////////////////
+static int SWP_inWindow (int left, int right, int seqNum)
+{
+  // returns true iff seqNum is between > left and <= right
+  if (left <= right)
+    return left<seqNum && seqNum<=right;
+  else
+    return left<seqNum || seqNum<=right;
+}
+};
+#endif
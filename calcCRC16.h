@@ -10,7 +10,7 @@
 
 #define CRC_POLY  0x18005
 
-int calcCRC (unsigned char *buf,int length)
+static int calcCRC (unsigned char *buf,int length)
 {
   unsigned char curr;
   unsigned int rem = 0;
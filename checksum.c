@@ -0,0 +1,324 @@
+//
+// File: checksum.c
+//
+// Author: Hamza Sultan Khan Niazi
+//
+// Description: Implementation of the integrity checks defined in
+// checksum.h.
+//
+#include <string.h> // memcpy
+#include "checksum.h"
+
+#define CK_CRC16_POLY  0x8005       // x^16+x^15+x^2+1, as in calcCRC16.h
+#define CK_CRC32C_POLY 0x82f63b78   // Castagnoli, bit reversed
+
+// multipliers for the 64 bit hash
+#define CK_K1 0x9e3779b185ebca87ULL
+#define CK_K2 0xc2b2ae3d27d4eb4fULL
+#define CK_K3 0x165667b19e3779f9ULL
+#define CK_K4 0x85ebca77c2b2ae63ULL
+
+#if defined(__x86_64__)
+#define CK_HAVE_SSE42 1
+#endif
+
+// define state variables
+
+static int CK_tablesBuilt = 0;
+static unsigned short CK_crc16Table [256];
+static unsigned int CK_crc32cTable [256];
+#ifdef CK_HAVE_SSE42
+static int CK_useSSE42;
+#endif
+
+// prototypes for local functions
+static void CK_buildTables (void);
+static unsigned int CK_crc32c (unsigned int crc, const unsigned char *buf,
+			       int len);
+static unsigned long long CK_hashWord (unsigned long long h,
+				       unsigned long long w);
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// CK_size
+//
+///////////////////////////////////////////////////////////////////////////////
+int CK_size (int policy)
+{
+  switch (policy)
+    {
+    case CK_NONE:   return 0;
+    case CK_CRC16:  return 2;
+    case CK_CRC32C: return 4;
+    case CK_HASH64: return 8;
+    }
+  return -1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// CK_begin
+//
+///////////////////////////////////////////////////////////////////////////////
+void CK_begin (struct CK_state *st, int policy)
+{
+  if (!CK_tablesBuilt)
+    CK_buildTables ();
+
+  st->policy = policy;
+  st->length = 0;
+  st->tailLen = 0;
+  switch (policy)
+    {
+    case CK_CRC32C:
+      st->value = 0xffffffff;
+      break;
+    case CK_HASH64:
+      st->value = CK_K3;
+      break;
+    default:
+      st->value = 0;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// CK_update
+//
+///////////////////////////////////////////////////////////////////////////////
+void CK_update (struct CK_state *st, const unsigned char *buf, int len)
+{
+  switch (st->policy)
+    {
+    case CK_CRC16:
+      CK_updateCRC16 (st,buf,len);
+      break;
+
+    case CK_CRC32C:
+      CK_updateCRC32C (st,buf,len);
+      break;
+
+    case CK_HASH64:
+      CK_updateHash64 (st,buf,len);
+      break;
+
+    default:
+      st->length += len;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// CK_updateCRC16
+//
+///////////////////////////////////////////////////////////////////////////////
+void CK_updateCRC16 (struct CK_state *st, const unsigned char *buf, int len)
+{
+  unsigned int crc = st->value;
+
+  st->length += len;
+  while (len-- > 0)
+    crc = ((crc << 8) ^ CK_crc16Table[((crc >> 8) ^ *buf++) & 0xff]) & 0xffff;
+  st->value = crc;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// CK_updateCRC32C
+//
+///////////////////////////////////////////////////////////////////////////////
+void CK_updateCRC32C (struct CK_state *st, const unsigned char *buf, int len)
+{
+  st->length += len;
+  st->value = CK_crc32c (st->value,buf,len);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// CK_updateHash64
+//
+///////////////////////////////////////////////////////////////////////////////
+void CK_updateHash64 (struct CK_state *st, const unsigned char *buf, int len)
+{
+  unsigned long long w;
+  int n;
+
+  st->length += len;
+
+  // top up a partial word left over from the last piece first
+  if (st->tailLen > 0)
+    {
+      n = 8 - st->tailLen;
+      if (n > len)
+	n = len;
+      memcpy (st->tail+st->tailLen,buf,n);
+      st->tailLen += n;
+      buf += n;
+      len -= n;
+      if (st->tailLen < 8)
+	return;
+      memcpy (&w,st->tail,8);
+      st->value = CK_hashWord (st->value,w);
+      st->tailLen = 0;
+    }
+  for (;len>=8;len-=8,buf+=8)
+    {
+      memcpy (&w,buf,8);
+      st->value = CK_hashWord (st->value,w);
+    }
+  memcpy (st->tail,buf,len);
+  st->tailLen = len;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// CK_end
+//
+///////////////////////////////////////////////////////////////////////////////
+unsigned long long CK_end (struct CK_state *st)
+{
+  switch (st->policy)
+    {
+    case CK_CRC16:
+      return st->value;
+
+    case CK_CRC32C:
+      return st->value ^ 0xffffffff;
+
+    case CK_HASH64:
+      return CK_endHash64 (st);
+    }
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// CK_endHash64
+//
+///////////////////////////////////////////////////////////////////////////////
+unsigned long long CK_endHash64 (struct CK_state *st)
+{
+  // fold in the last partial word and the length, then mix the bits
+  unsigned long long h = st->value;
+  unsigned long long w = 0;
+
+  if (st->tailLen > 0)
+    {
+      memcpy (&w,st->tail,st->tailLen);
+      h = CK_hashWord (h,w);
+    }
+  h ^= st->length;
+  h ^= h >> 33;
+  h *= CK_K2;
+  h ^= h >> 29;
+  h *= CK_K3;
+  h ^= h >> 32;
+  return h;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// CK_compute
+//
+///////////////////////////////////////////////////////////////////////////////
+unsigned long long CK_compute (int policy, const unsigned char *buf, int len)
+{
+  struct CK_state st;
+
+  if (policy == CK_NONE)
+    return 0;
+  CK_begin (&st,policy);
+  CK_update (&st,buf,len);
+  return CK_end (&st);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// CK_buildTables
+//
+///////////////////////////////////////////////////////////////////////////////
+static void CK_buildTables (void)
+{
+  unsigned int c;
+  int i,k;
+
+  for (i=0;i<256;i++)
+    {
+      // CRC-16 is computed high bit first
+      c = i << 8;
+      for (k=0;k<8;k++)
+	c = (c & 0x8000) ? (c << 1) ^ CK_CRC16_POLY : c << 1;
+      CK_crc16Table[i] = c & 0xffff;
+
+      // CRC-32C is computed low bit first
+      c = i;
+      for (k=0;k<8;k++)
+	c = (c & 1) ? (c >> 1) ^ CK_CRC32C_POLY : c >> 1;
+      CK_crc32cTable[i] = c;
+    }
+
+#ifdef CK_HAVE_SSE42
+  CK_useSSE42 = __builtin_cpu_supports ("sse4.2");
+#endif
+  CK_tablesBuilt = 1;
+}
+
+#ifdef CK_HAVE_SSE42
+///////////////////////////////////////////////////////////////////////////////
+//
+// CK_crc32cSSE42
+//
+///////////////////////////////////////////////////////////////////////////////
+__attribute__((target("sse4.2")))
+static unsigned int CK_crc32cSSE42 (unsigned int crc, const unsigned char *buf,
+				    int len)
+{
+  // eight bytes per crc32 instruction, then a byte at a time
+  unsigned long long c = crc;
+  unsigned long long w;
+
+  for (;len>=8;len-=8,buf+=8)
+    {
+      memcpy (&w,buf,8);
+      c = __builtin_ia32_crc32di (c,w);
+    }
+  crc = c;
+  while (len-- > 0)
+    crc = __builtin_ia32_crc32qi (crc,*buf++);
+  return crc;
+}
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// CK_crc32c
+//
+///////////////////////////////////////////////////////////////////////////////
+static unsigned int CK_crc32c (unsigned int crc, const unsigned char *buf,
+			       int len)
+{
+#ifdef CK_HAVE_SSE42
+  if (CK_useSSE42)
+    return CK_crc32cSSE42 (crc,buf,len);
+#endif
+
+  while (len-- > 0)
+    crc = (crc >> 8) ^ CK_crc32cTable[(crc ^ *buf++) & 0xff];
+  return crc;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// CK_hashWord
+//
+///////////////////////////////////////////////////////////////////////////////
+static unsigned long long CK_hashWord (unsigned long long h,
+				       unsigned long long w)
+{
+  w *= CK_K2;
+  w = (w << 31) | (w >> 33);
+  w *= CK_K1;
+  h ^= w;
+  h = (h << 27) | (h >> 37);
+  return h * CK_K1 + CK_K4;
+}
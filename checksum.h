@@ -0,0 +1,64 @@
+//
+// File: checksum.h
+//
+// Author: Hamza Sultan Khan Niazi
+//
+// Description: Integrity checks for frames.  The policy numbers match the
+// SWP_CHECK_* values in SWP.h:
+//    CK_NONE    no check at all, for paths where UDP's checksum is enough
+//    CK_CRC16   the CRC-16 polynomial of calcCRC16.h, table driven
+//    CK_CRC32C  CRC-32C, using the SSE4.2 crc32 instruction when the CPU
+//               has it
+//    CK_HASH64  a fast 64 bit multiply/rotate hash of 8 byte words
+//
+// The following functions are defined:
+//    CK_size (int policy)
+//    CK_begin (struct CK_state *st, int policy)
+//    CK_update (struct CK_state *st, const unsigned char *buf, int len)
+//    CK_end (struct CK_state *st)
+//    CK_compute (int policy, const unsigned char *buf, int len)
+//    CK_updateCRC16 (struct CK_state *st, const unsigned char *buf, int len)
+//    CK_updateCRC32C (struct CK_state *st, const unsigned char *buf, int len)
+//    CK_updateHash64 (struct CK_state *st, const unsigned char *buf, int len)
+//    CK_endHash64 (struct CK_state *st)
+//
+#ifndef _CHECKSUM_H
+#define _CHECKSUM_H
+
+#define CK_NONE   0
+#define CK_CRC16  1
+#define CK_CRC32C 2
+#define CK_HASH64 3
+#define CK_NUM_POLICIES 4
+
+// running state of a check computed a piece at a time
+struct CK_state {
+  int policy;
+  unsigned long long value;
+  unsigned long long length;     // bytes seen so far
+  unsigned char tail[8];         // bytes not yet folded into a hash word
+  int tailLen;
+};
+
+int CK_size (int policy);
+// returns the number of bytes in a check value of the given policy, or a
+// negative value if there is no such policy.
+
+void CK_begin (struct CK_state *st, int policy);
+void CK_update (struct CK_state *st, const unsigned char *buf, int len);
+unsigned long long CK_end (struct CK_state *st);
+// compute a check value over data that isn't contiguous: CK_begin, then
+// CK_update for each piece, then CK_end returns the check value.
+
+unsigned long long CK_compute (int policy, const unsigned char *buf, int len);
+// returns the check value of the len bytes at buf.
+
+void CK_updateCRC16 (struct CK_state *st, const unsigned char *buf, int len);
+void CK_updateCRC32C (struct CK_state *st, const unsigned char *buf, int len);
+void CK_updateHash64 (struct CK_state *st, const unsigned char *buf, int len);
+unsigned long long CK_endHash64 (struct CK_state *st);
+// CK_update, and CK_end for CK_HASH64, for a state whose policy the
+// caller already knows, without looking at st->policy.  A CK_CRC16 check
+// value is st->value once updated, and a CK_CRC32C one st->value ^
+// 0xffffffff.
+#endif
@@ -0,0 +1,44 @@
+//
+// File: echo.h
+//
+// Author: Hamza Sultan Khan Niazi
+//
+// Description: The messages of the echo benchmark, shared by echoServer
+// and echoClient.  A client says hello to the server's port in a UDP
+// datagram, a hello message whose number is the port the client takes
+// answers on, and says it again every ECHO_HELLO_USECS until the server
+// answers with a hello whose number is the port the client is to send
+// to.  The server has set up a receiver there for that client alone, and
+// opened a session back to the client's port, so each end both sends and
+// receives; the server serves every client at once this way.  Many
+// client sessions are carried over each pair of SWP sessions, each
+// message saying which it belongs to.  Every message starts with a
+// header, most significant byte first:
+//    bytes 0-3   client session, or ECHO_HELLO or ECHO_BYE
+//    bytes 4-7   request number within the session; for a hello, the
+//                port the client takes answers on, or in the answer,
+//                the port to send to
+//    bytes 8-15  time the request was due to be sent, in nanoseconds on
+//                the client's monotonic clock
+// and is padded out to the request size.  The server sends every message
+// back as it is, the bye included, once it has sent back everything
+// before it.
+//
+#ifndef _ECHO_H
+#define _ECHO_H
+
+#define ECHO_HEADER_SIZE 16
+#define ECHO_HELLO 0xffffffffU
+#define ECHO_BYE   0xfffffffeU
+
+// most client sessions the server keeps count of
+#define ECHO_MAX_SESSIONS 65536
+
+// how often, and how many times, a client says hello before it gives up
+#define ECHO_HELLO_USECS 250000
+#define ECHO_HELLO_TRIES 40
+
+// seconds each end stays around once it has said or heard bye, to answer
+// resent frames in case its last acks were lost
+#define ECHO_LINGER 2
+#endif
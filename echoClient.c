@@ -0,0 +1,441 @@
+//
+// File: echoClient.c
+//
+// Author: Hamza Sultan Khan Niazi
+//
+// Description: Drives echoServer with requests from many sessions at a
+// fixed rate and reports the spread of their round trip times.
+//
+//    echoClient [options] <hostname> <port>
+//
+// The client says hello to the server's port, which gives it a port to
+// open its session to, and takes the answers on a port of its own (see
+// echo.h); unless -l names one, that is the first of as many free ports in
+// a row as there are stripes.  Requests go out open loop: request i is
+// due i/rate seconds after the start, whatever has come back so far, and
+// goes to session i modulo the number of sessions.  A round trip is timed
+// from when its request was due, not from when SWP_send got to it, so time
+// spent behind a full window or a slow server counts against it as it
+// would for a client that couldn't wait.  A thread of its own takes the
+// answers as they come in.
+//
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <sys/time.h> // struct timeval
+#include <errno.h>
+#include <time.h>    // clock_nanosleep
+#include <stdlib.h>  // exit, qsort
+#include <unistd.h>  // getopt
+#include <string.h>  // strcmp, memset
+#include <pthread.h>
+#include "SWP.h"
+#include "unreliableSend.h"
+#include "echo.h"
+
+// integrity policies that may be named on the command line
+static char *checkNames[] = {"none","crc16","crc32c","hash64"};
+
+// prototypes for local functions
+static int freePorts (int num);
+static int sayHello (char *hostname, int port, int localPort);
+static void *takeAnswers (void *arg);
+static void request (unsigned char *buf, int size, unsigned long session,
+		     unsigned long number, long long due);
+static long long now (void);
+static void putLong (unsigned char *p, unsigned long long v, int bytes);
+static unsigned long long getLong (const unsigned char *p, int bytes);
+static int byValue (const void *a, const void *b);
+
+// the round trip time of each request, in nanoseconds, or -1 until it is
+// answered; request i is number i / numSessions of session i % numSessions.
+// Only takeAnswers writes roundTrip and numAnswered, and main reads them
+// once it has been joined, so they need no lock.
+static long long *roundTrip;
+static long numRequests;
+static int numSessions;
+static long numAnswered;
+
+int main (int argc, char *argv[]) {
+  unsigned char buf[SWP_DEFAULT_PAYLOAD];
+  int winSize=32,errorRate=0;
+  int checkPolicy=SWP_CHECK_CRC16;
+  int stripes=1;
+  int compress=0;
+  int coalesce=0;
+  int backend=SWP_BACKEND_SOCKETS;
+  int sharedMemory=1;
+  int opt,badUsage=0;
+  int msgSize=64,port,localPort=0,serverPort;
+  double rate=1000,seconds=5;
+  long long start,due,lag,maxLag,*sorted;
+  struct timespec when,linger;
+  pthread_t answers;
+  long i,n;
+
+  numSessions = 100;
+
+  // get options and arguments from command line
+  while ((opt = getopt(argc,argv,"w:e:s:c:S:zC:n:r:d:b:l:UN")) != -1)
+    switch (opt) {
+    case 'w':
+      winSize = atoi(optarg);
+      break;
+    case 'e':
+      errorRate = atoi(optarg);
+      break;
+    case 's':
+      US_SetSeed (strtoull(optarg,0,0));
+      break;
+    case 'c':
+      for (checkPolicy=0;checkPolicy<4;checkPolicy++)
+	if (!strcmp(optarg,checkNames[checkPolicy]))
+	  break;
+      badUsage |= (checkPolicy==4);
+      break;
+    case 'S':
+      stripes = atoi(optarg);
+      break;
+    case 'z':
+      compress = 1;
+      break;
+    case 'C':
+      coalesce = atoi(optarg);
+      break;
+    case 'U':
+      backend = SWP_BACKEND_URING;
+      break;
+    case 'N':
+      sharedMemory = 0;
+      break;
+    case 'n':
+      numSessions = atoi(optarg);
+      break;
+    case 'r':
+      rate = atof(optarg);
+      break;
+    case 'd':
+      seconds = atof(optarg);
+      break;
+    case 'b':
+      msgSize = atoi(optarg);
+      break;
+    case 'l':
+      localPort = atoi(optarg);
+      break;
+    default:
+      badUsage = 1;
+    }
+  if (badUsage || argc-optind != 2 || numSessions < 1 ||
+      numSessions > ECHO_MAX_SESSIONS || rate <= 0 || seconds <= 0 ||
+      msgSize < ECHO_HEADER_SIZE || msgSize > SWP_DEFAULT_PAYLOAD) {
+    printf("usage: echoClient [-w WinSize] [-e errorRate] [-s seed]\n"
+	   "                  [-c none|crc16|crc32c|hash64] [-S Stripes] [-z]\n"
+	   "                  [-C CoalesceUsecs] [-U] [-N] [-n Sessions]\n"
+	   "                  [-r RequestsPerSec] [-d Seconds] [-b RequestSize]\n"
+	   "                  [-l LocalPort]\n"
+	   "                  <hostname> <port>\n"
+	   "Requests are %d to %d bytes, and there are at most %d sessions.\n",
+	   ECHO_HEADER_SIZE,SWP_DEFAULT_PAYLOAD,ECHO_MAX_SESSIONS);
+    exit (1);
+  }
+  port = atoi(argv[optind+1]);
+  if (!localPort && (localPort = freePorts(stripes)) < 0) {
+    printf ("No free ports to take answers on\n");
+    exit (1);
+  }
+
+  numRequests = rate * seconds;
+  roundTrip = malloc ((numRequests + 1) * sizeof(*roundTrip));
+  sorted = malloc ((numRequests + 1) * sizeof(*sorted));
+  if (!roundTrip || !sorted) {
+    printf ("out of memory\n");
+    exit (1);
+  }
+  for (i=0;i<numRequests;i++)
+    roundTrip[i] = -1;
+
+  // session parameters, for both directions
+  SWP_setIntegrity (checkPolicy);
+  if (SWP_setStripes(stripes))
+    exit (1);
+  SWP_setCompression (compress);
+  if (SWP_setCoalescing(coalesce))
+    exit (1);
+  SWP_setBackend (backend);
+  SWP_setSharedMemory (sharedMemory);
+
+  // be ready for answers before asking anything
+  if (SWP_recvInit(localPort,winSize) < 0) {
+    printf ("recvInit Failed\n");
+    exit (1);
+  }
+  if ((serverPort = sayHello(argv[optind],port,localPort)) < 0) {
+    printf ("No answer from the server\n");
+    exit (1);
+  }
+  if (SWP_sendInit(argv[optind],serverPort,winSize) < 0) {
+    printf ("sendInit Failed\n");
+    exit (1);
+  }
+  US_SetFailureProb (errorRate);
+
+  // the thread that times answers starts only once roundTrip is filled
+  // in, so it never sees an entry before its -1
+  if (pthread_create (&answers,0,takeAnswers,0) != 0) {
+    printf ("Can't start the thread for answers\n");
+    exit (1);
+  }
+
+  // send each request when it's due
+  start = now ();
+  maxLag = 0;
+  for (i=0;i<numRequests;i++)
+    {
+      due = start + (long long)(i * 1000000000.0 / rate);
+      when.tv_sec = due / 1000000000;
+      when.tv_nsec = due % 1000000000;
+      while (clock_nanosleep (CLOCK_MONOTONIC,TIMER_ABSTIME,&when,0) == EINTR)
+	;
+      if ((lag = now () - due) > maxLag)
+	maxLag = lag;
+
+      request (buf,msgSize,i % numSessions,i / numSessions,due);
+      SWP_send ((char *)buf,msgSize);
+    }
+
+  // the server sends bye back once it has answered everything else
+  request (buf,ECHO_HEADER_SIZE,ECHO_BYE,0,0);
+  SWP_send ((char *)buf,ECHO_HEADER_SIZE);
+  pthread_join (answers,0);
+
+  // gather the round trips that were answered
+  for (i=n=0;i<numRequests;i++)
+    if (roundTrip[i] >= 0)
+      sorted[n++] = roundTrip[i];
+  qsort (sorted,n,sizeof(*sorted),byValue);
+
+  printf ("%ld requests over %d sessions at %.0f/sec, %ld answered.\n",
+	  numRequests,numSessions,rate,numAnswered);
+  printf ("Requests went out at most %.1f usecs late.\n",maxLag / 1000.0);
+  if (n > 0)
+    {
+      printf ("\n%-10s %10s %10s %10s %10s %10s   (usecs)\n",
+	      "","p50","p90","p99","p99.9","max");
+      printf ("%-10s %10.1f %10.1f %10.1f %10.1f %10.1f\n","round trip",
+	      sorted[(n - 1) * 50 / 100] / 1000.0,
+	      sorted[(n - 1) * 90 / 100] / 1000.0,
+	      sorted[(n - 1) * 99 / 100] / 1000.0,
+	      sorted[(n - 1) * 999 / 1000] / 1000.0,
+	      sorted[n - 1] / 1000.0);
+    }
+
+  // stay around for a while in case there are acks that still need to be
+  // sent back; the sleep is cut short by every signal
+  linger.tv_sec = ECHO_LINGER;
+  linger.tv_nsec = 0;
+  while (nanosleep(&linger,&linger) < 0 && errno == EINTR)
+    ;
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// freePorts
+//
+///////////////////////////////////////////////////////////////////////////////
+static int freePorts (int num)
+{
+  // the first of num UDP ports in a row that are free just now, or -1.
+  // The system picks the first, and we look for another if any that
+  // follow it are taken.
+  struct sockaddr_in addr;
+  socklen_t addrSize;
+  int socks[SWP_MAX_STRIPES];
+  int i,n,port,tries;
+
+  for (tries=0;tries<100;tries++)
+    {
+      memset (&addr,0,sizeof(addr));
+      addr.sin_family = AF_INET;
+      addr.sin_addr.s_addr = INADDR_ANY;
+      addrSize = sizeof(addr);
+      port = -1;
+      if ((socks[0] = socket(PF_INET,SOCK_DGRAM,IPPROTO_UDP)) < 0)
+	return -1;
+      if (bind (socks[0],(struct sockaddr *)&addr,sizeof(addr)) == 0 &&
+	  getsockname (socks[0],(struct sockaddr *)&addr,&addrSize) == 0)
+	port = ntohs(addr.sin_port);
+      for (n=1;n<num && port > 0 && port + n < 65536;n++)
+	{
+	  addr.sin_port = htons(port + n);
+	  if ((socks[n] = socket(PF_INET,SOCK_DGRAM,IPPROTO_UDP)) < 0)
+	    break;
+	  if (bind (socks[n],(struct sockaddr *)&addr,sizeof(addr)) < 0)
+	    {
+	      close (socks[n]);
+	      break;
+	    }
+	}
+      for (i=0;i<n;i++)
+	close (socks[i]);
+      if (port > 0 && n == num)
+	return port;
+    }
+  return -1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// sayHello
+//
+///////////////////////////////////////////////////////////////////////////////
+static int sayHello (char *hostname, int port, int localPort)
+{
+  // tell the server on hostname's port that we take answers on localPort,
+  // until it answers with the port to open our session to.  Returns that
+  // port, or -1 if the server never answers.
+  unsigned char buf[ECHO_HEADER_SIZE];
+  struct sockaddr_in addr;
+  struct hostent *host;
+  struct timeval wait;
+  int sock,len,tries;
+
+  if (!(host = gethostbyname(hostname)))
+    return -1;
+  memset (&addr,0,sizeof(addr));
+  addr.sin_family = AF_INET;
+  memcpy (&addr.sin_addr,host->h_addr,sizeof(addr.sin_addr));
+  addr.sin_port = htons(port);
+
+  wait.tv_sec = ECHO_HELLO_USECS / 1000000;
+  wait.tv_usec = ECHO_HELLO_USECS % 1000000;
+  if ((sock = socket(PF_INET,SOCK_DGRAM,IPPROTO_UDP)) < 0 ||
+      connect (sock,(struct sockaddr *)&addr,sizeof(addr)) < 0 ||
+      setsockopt (sock,SOL_SOCKET,SO_RCVTIMEO,&wait,sizeof(wait)) < 0)
+    return -1;
+
+  // the same hello each time, from the same socket, so that the server
+  // answers it once however many times it gets it
+  for (tries=0;tries<ECHO_HELLO_TRIES;tries++)
+    {
+      request (buf,ECHO_HEADER_SIZE,ECHO_HELLO,localPort,0);
+      send (sock,buf,ECHO_HEADER_SIZE,0);
+      while ((len = recv (sock,buf,sizeof(buf),0)) >= 0 || errno == EINTR)
+	if (len == ECHO_HEADER_SIZE && getLong(buf,4) == ECHO_HELLO)
+	  {
+	    close (sock);
+	    return getLong(buf+4,4);
+	  }
+    }
+  close (sock);
+  return -1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// takeAnswers
+//
+///////////////////////////////////////////////////////////////////////////////
+static void *takeAnswers (void *arg)
+{
+  // time the answers as they come in, until the server says bye
+  unsigned char buf[SWP_MAX_PAYLOAD];
+  unsigned long session,number;
+  long long at;
+  long i;
+  int len;
+
+  while (1)
+    {
+      SWP_recv ((char *)buf,&len);
+      at = now ();
+      if (len < ECHO_HEADER_SIZE)
+	continue;
+      session = getLong(buf,4);
+      number = getLong(buf+4,4);
+      if (session == ECHO_BYE)
+	break;
+      if (session >= (unsigned long)numSessions)
+	continue;
+
+      i = number * numSessions + session;
+      if (i < numRequests && roundTrip[i] < 0)
+	{
+	  roundTrip[i] = at - getLong(buf+8,8);
+	  numAnswered++;
+	}
+    }
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// request
+//
+///////////////////////////////////////////////////////////////////////////////
+static void request (unsigned char *buf, int size, unsigned long session,
+		     unsigned long number, long long due)
+{
+  // build a size byte request in buf
+  memset (buf,0,size);
+  putLong (buf,session,4);
+  putLong (buf+4,number,4);
+  putLong (buf+8,due,8);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// now
+//
+///////////////////////////////////////////////////////////////////////////////
+static long long now (void)
+{
+  struct timespec t;
+
+  clock_gettime (CLOCK_MONOTONIC,&t);
+  return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// putLong
+//
+///////////////////////////////////////////////////////////////////////////////
+static void putLong (unsigned char *p, unsigned long long v, int bytes)
+{
+  // store the low bytes of v, most significant first
+  while (bytes-- > 0)
+    {
+      p[bytes] = v & 0xff;
+      v >>= 8;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// getLong
+//
+///////////////////////////////////////////////////////////////////////////////
+static unsigned long long getLong (const unsigned char *p, int bytes)
+{
+  unsigned long long v = 0;
+
+  while (bytes-- > 0)
+    v = (v << 8) | *p++;
+  return v;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// byValue
+//
+///////////////////////////////////////////////////////////////////////////////
+static int byValue (const void *a, const void *b)
+{
+  const long long *x = a, *y = b;
+
+  return *x < *y ? -1 : *x > *y;
+}
@@ -0,0 +1,381 @@
+//
+// File: echoServer.cpp
+//
+// Author: Hamza Sultan Khan Niazi
+//
+// Description: Sends every message that comes in back where it came from,
+// for echoClient to measure round trips with.
+//
+//    echoServer [options] <port>
+//
+// Clients say hello on port (see echo.h).  Each is given a port of its
+// own, ECHO_CLIENT_PORT, where an engine set up for that client alone
+// takes its messages, and the engine opens a session back to the port the
+// client takes answers on.  One process serves every client at once, each
+// with an engine and a thread of its own, so the server is written in C++
+// against SWP.hpp rather than the C interface, which has one engine per
+// process.  Up to ECHO_MAX_CLIENTS are served at a time; a client that
+// says hello when there's no room isn't answered, and says it again until
+// there is or it gives up.  The messages of each client session are
+// counted, and a summary printed when the client says bye.
+//
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h> // inet_ntop
+#include <errno.h>
+#include <time.h>    // nanosleep
+#include <stdlib.h>  // exit, calloc
+#include <unistd.h>  // getopt
+#include <string.h>  // strcmp
+#include <pthread.h>
+#include <new>       // placement new
+#include "SWP.hpp"
+#include "echo.h"
+
+// the engine each client is served by, built as the C interface's is
+typedef Swp<SWP_MAX_PAYLOAD, 128, SWP_CheckCRC16, SWP_IoAny> ECHO_engine;
+
+// most clients served at once, and the port client n of a server on port
+// is given, with room after it for its stripes
+#define ECHO_MAX_CLIENTS 32
+#define ECHO_CLIENT_PORT(port,n) ((port) + ((n) + 1) * SWP_MAX_STRIPES)
+
+// a client being served.  Its hello is known by the address it came from
+// and the port it gives, so that a hello said again after we've answered
+// it is answered the same way.  inUse is guarded by clientsMutex; the rest
+// belongs to whoever set inUse.
+struct client {
+  int inUse;
+  struct sockaddr_in addr;   // where its hello came from
+  int replyPort;             // the port it takes answers on
+  int port;                  // the port we gave it
+  ECHO_engine *engine;
+};
+
+static struct client clients[ECHO_MAX_CLIENTS];
+static pthread_mutex_t clientsMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// integrity policies that may be named on the command line
+static const char *checkNames[] = {"none","crc16","crc32c","hash64"};
+
+// session parameters, for every engine and both directions
+static int winSize=32;
+static int checkPolicy=SWP_CHECK_CRC16;
+static int stripes=1;
+static int compress=0;
+static int coalesce=0;
+static int backend=SWP_BACKEND_SOCKETS;
+static int sharedMemory=1;
+
+// prototypes for local functions
+static int welcome (int port, struct sockaddr_in *addr, int replyPort);
+static ECHO_engine *startEngine (int port, char *host, int replyPort);
+static void *serve (void *arg);
+static void putLong (unsigned char *p, unsigned long v, int bytes);
+static unsigned long getLong (const unsigned char *p, int bytes);
+
+int main (int argc, char *argv[]) {
+  unsigned char buf[ECHO_HEADER_SIZE];
+  struct sockaddr_in addr;
+  socklen_t addrSize;
+  int errorRate=0;
+  int opt,badUsage=0;
+  int sock,port,len,n;
+
+  // get options and arguments from command line
+  while ((opt = getopt(argc,argv,"w:e:s:c:S:zC:UN")) != -1)
+    switch (opt) {
+    case 'w':
+      winSize = atoi(optarg);
+      break;
+    case 'e':
+      errorRate = atoi(optarg);
+      break;
+    case 's':
+      US_SetSeed (strtoull(optarg,0,0));
+      break;
+    case 'c':
+      for (checkPolicy=0;checkPolicy<4;checkPolicy++)
+	if (!strcmp(optarg,checkNames[checkPolicy]))
+	  break;
+      badUsage |= (checkPolicy==4);
+      break;
+    case 'S':
+      stripes = atoi(optarg);
+      break;
+    case 'z':
+      compress = 1;
+      break;
+    case 'C':
+      coalesce = atoi(optarg);
+      break;
+    case 'U':
+      backend = SWP_BACKEND_URING;
+      break;
+    case 'N':
+      sharedMemory = 0;
+      break;
+    default:
+      badUsage = 1;
+    }
+  if (badUsage || argc-optind != 1) {
+    printf("usage: echoServer [-w WinSize] [-e errorRate] [-s seed]\n"
+	   "                  [-c none|crc16|crc32c|hash64] [-S Stripes] [-z]\n"
+	   "                  [-C CoalesceUsecs] [-U] [-N] <port>\n");
+    exit (1);
+  }
+  port = atoi(argv[optind]);
+  if (port <= 0 || ECHO_CLIENT_PORT(port,ECHO_MAX_CLIENTS) > 65536) {
+    printf ("The port must leave room for %d clients after it.\n",
+	    ECHO_MAX_CLIENTS);
+    exit (1);
+  }
+  US_SetFailureProb (errorRate);
+
+  // the port clients say hello on
+  memset (&addr,0,sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = INADDR_ANY;
+  addr.sin_port = htons(port);
+  if ((sock = socket(PF_INET,SOCK_DGRAM,IPPROTO_UDP)) < 0 ||
+      bind (sock,(struct sockaddr *)&addr,sizeof(addr)) < 0) {
+    perror ("echoServer: bind");
+    exit (1);
+  }
+
+  // answer each hello with the port its client is served on.  The engines'
+  // signals cut the wait short all the time.
+  while (1)
+    {
+      addrSize = sizeof(addr);
+      len = recvfrom (sock,buf,sizeof(buf),0,(struct sockaddr *)&addr,
+		      &addrSize);
+      if (len < 0 && errno == EINTR)
+	continue;
+      if (len < 0) {
+	perror ("echoServer: recvfrom");
+	exit (1);
+      }
+      if (len < ECHO_HEADER_SIZE || getLong(buf,4) != ECHO_HELLO)
+	continue;
+      if ((n = welcome (port,&addr,getLong(buf+4,4))) < 0)
+	continue;
+      putLong (buf+4,clients[n].port,4);
+      sendto (sock,buf,ECHO_HEADER_SIZE,0,(struct sockaddr *)&addr,
+	      sizeof(addr));
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// welcome
+//
+///////////////////////////////////////////////////////////////////////////////
+static int welcome (int port, struct sockaddr_in *addr, int replyPort)
+{
+  // find the client that said hello from addr, taking answers on
+  // replyPort, or start serving it if it's new.  Returns its index in
+  // clients, or -1 if it can't be served now.
+  struct client *client;
+  pthread_t thread;
+  char host[64];
+  int n,found;
+
+  // a hello said again is answered as before
+  pthread_mutex_lock (&clientsMutex);
+  for (n=found=0;n<ECHO_MAX_CLIENTS && !found;n++)
+    found = clients[n].inUse &&
+      clients[n].addr.sin_addr.s_addr == addr->sin_addr.s_addr &&
+      clients[n].addr.sin_port == addr->sin_port &&
+      clients[n].replyPort == replyPort;
+  if (found)
+    {
+      pthread_mutex_unlock (&clientsMutex);
+      return n - 1;
+    }
+  for (n=0;n<ECHO_MAX_CLIENTS && clients[n].inUse;n++)
+    ;
+  if (n == ECHO_MAX_CLIENTS)
+    {
+      pthread_mutex_unlock (&clientsMutex);
+      return -1;
+    }
+  client = &clients[n];
+  client->inUse = 1;
+  pthread_mutex_unlock (&clientsMutex);
+
+  client->addr = *addr;
+  client->replyPort = replyPort;
+  client->port = ECHO_CLIENT_PORT(port,n);
+  inet_ntop (AF_INET,&addr->sin_addr,host,sizeof(host));
+  client->engine = startEngine (client->port,host,replyPort);
+  if (client->engine &&
+      pthread_create (&thread,0,serve,client) == 0 &&
+      pthread_detach (thread) == 0)
+    {
+      printf ("Serving %s on port %d, answering on port %d.\n",host,
+	      client->port,replyPort);
+      fflush (stdout);
+      return n;
+    }
+
+  printf ("Can't serve %s on port %d.\n",host,client->port);
+  if (client->engine)
+    {
+      client->engine->SWP_close ();
+      free (client->engine);
+    }
+  pthread_mutex_lock (&clientsMutex);
+  client->inUse = 0;
+  pthread_mutex_unlock (&clientsMutex);
+  return -1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// startEngine
+//
+///////////////////////////////////////////////////////////////////////////////
+static ECHO_engine *startEngine (int port, char *host, int replyPort)
+{
+  // an engine receiving on port and sending to replyPort on host, or null
+  // if one can't be had.  A client that goes quiet mid-session fails its
+  // engine rather than ending the process.
+  ECHO_engine *engine;
+  void *memory;
+
+  if (!(memory = calloc (1,sizeof(ECHO_engine))))
+    return 0;
+  engine = new (memory) ECHO_engine;
+  engine->SWP_setIntegrity (checkPolicy);
+  engine->SWP_setCompression (compress);
+  engine->SWP_setBackend (backend);
+  engine->SWP_setSharedMemory (sharedMemory);
+  engine->SWP_setExitOnFailure (0);
+  if (engine->SWP_setStripes(stripes) < 0 ||
+      engine->SWP_setCoalescing(coalesce) < 0 ||
+      engine->SWP_recvInit(port,winSize) < 0 ||
+      engine->SWP_sendInit(host,replyPort,winSize) < 0)
+    {
+      engine->SWP_close ();
+      free (engine);
+      return 0;
+    }
+  return engine;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// serve
+//
+///////////////////////////////////////////////////////////////////////////////
+static void *serve (void *arg)
+{
+  // serve a client until it says bye or its engine gives up on it, then
+  // let go of its engine and its place in clients
+  struct client *client = (struct client *)arg;
+  ECHO_engine *engine = client->engine;
+  unsigned char buf[SWP_MAX_PAYLOAD];
+  unsigned long session;
+  long *requests;
+  long numRequests=0;
+  long long bytes=0;
+  int numSessions=0;
+  int len,port;
+  struct timeval startTime,stopTime;
+  struct timespec linger;
+  struct SWP_stats stats;
+  double elapsed;
+
+  port = client->port;
+  requests = (long *)calloc (ECHO_MAX_SESSIONS,sizeof(*requests));
+  gettimeofday (&startTime,0);
+
+  // send everything back until the client says bye, and that too
+  while (requests)
+    {
+      engine->SWP_recv ((char *)buf,&len);
+      if (len < 0)
+	break;
+      if (len < ECHO_HEADER_SIZE)
+	continue;
+      engine->SWP_send ((char *)buf,len);
+
+      session = getLong(buf,4);
+      if (session == ECHO_BYE)
+	break;
+      if (session < ECHO_MAX_SESSIONS && requests[session]++ == 0)
+	numSessions++;
+      numRequests++;
+      bytes += len;
+    }
+  engine->SWP_flush ();
+  gettimeofday (&stopTime,0);
+
+  // each line is printed whole, since other clients' may come between
+  elapsed = (stopTime.tv_sec - startTime.tv_sec) +
+    (stopTime.tv_usec - startTime.tv_usec) / 1000000.0;
+  if (!requests)
+    printf ("Port %d: out of memory\n",port);
+  else if (len < 0)
+    printf ("Port %d: the client has gone.\n",port);
+  printf ("Port %d: %ld requests from %d sessions, %lld bytes, in %.3f"
+	  " seconds (%.0f requests/sec).\n",port,numRequests,numSessions,
+	  bytes,elapsed,elapsed > 0 ? numRequests / elapsed : 0.0);
+  engine->SWP_getStats (&stats);
+  printf ("Port %d: %ld frames sent, %ld retransmitted; %ld received,"
+	  " %ld bad.\n",port,stats.framesSent,stats.framesRetransmitted,
+	  stats.framesReceived,stats.badFrames);
+  if (stats.framesCoalesced)
+    printf ("Port %d: %ld messages packed into %ld frames.\n",port,
+	    stats.messagesCoalesced,stats.framesCoalesced);
+  fflush (stdout);
+  free (requests);
+
+  // stay around for a while in case there are acks that still need to be
+  // sent back; the sleep is cut short by every signal
+  linger.tv_sec = ECHO_LINGER;
+  linger.tv_nsec = 0;
+  while (nanosleep(&linger,&linger) < 0 && errno == EINTR)
+    ;
+
+  engine->SWP_close ();
+  free (engine);
+  pthread_mutex_lock (&clientsMutex);
+  client->inUse = 0;
+  pthread_mutex_unlock (&clientsMutex);
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// putLong
+//
+///////////////////////////////////////////////////////////////////////////////
+static void putLong (unsigned char *p, unsigned long v, int bytes)
+{
+  // store the low bytes of v, most significant first
+  while (bytes-- > 0)
+    {
+      p[bytes] = v & 0xff;
+      v >>= 8;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// getLong
+//
+///////////////////////////////////////////////////////////////////////////////
+static unsigned long getLong (const unsigned char *p, int bytes)
+{
+  // the bytes byte number at p, most significant byte first
+  unsigned long v = 0;
+
+  while (bytes-- > 0)
+    v = (v << 8) | *p++;
+  return v;
+}
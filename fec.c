@@ -0,0 +1,182 @@
+//
+// File: fec.c
+//
+// Author: Hamza Sultan Khan Niazi
+//
+// Description: Implementation of the block erasure code defined in fec.h.
+// Arithmetic is in GF(2^8) with the polynomial x^8+x^4+x^3+x^2+1, in which
+// addition is XOR and multiplication goes through log and exp tables.
+//
+#include "fec.h"
+
+#define FEC_POLY 0x11d
+
+// define state variables
+
+static int FEC_tablesBuilt = 0;
+static unsigned char FEC_exp [512];  // doubled so log sums need no modulo
+static unsigned char FEC_log [256];
+
+// prototypes for local functions
+static void FEC_buildTables (void);
+static unsigned char FEC_mul (unsigned char a, unsigned char b);
+static unsigned char FEC_inv (unsigned char a);
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// FEC_coef
+//
+///////////////////////////////////////////////////////////////////////////////
+unsigned char FEC_coef (int parityIndex, int frameIndex)
+{
+  // alpha^(i*j); alpha has order 255
+  if (!FEC_tablesBuilt)
+    FEC_buildTables ();
+  return FEC_exp[(parityIndex * frameIndex) % 255];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// FEC_addScaled
+//
+///////////////////////////////////////////////////////////////////////////////
+void FEC_addScaled (unsigned char *dst, const unsigned char *src, int len,
+		    unsigned char coef)
+{
+  unsigned char row[256];
+  int i;
+
+  if (coef == 0)
+    return;
+
+  // plain XOR parity is the common case
+  if (coef == 1)
+    {
+      for (i=0;i<len;i++)
+	dst[i] ^= src[i];
+      return;
+    }
+
+  // build the multiplication row for coef once rather than going through
+  // the log tables for every byte
+  for (i=0;i<256;i++)
+    row[i] = FEC_mul (coef,i);
+  for (i=0;i<len;i++)
+    dst[i] ^= row[src[i]];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// FEC_solve
+//
+///////////////////////////////////////////////////////////////////////////////
+int FEC_solve (int numMissing, const int *missing, const int *parityIndex,
+	       unsigned char **syndromes, int size)
+{
+  // Gauss-Jordan elimination on the numMissing x numMissing system
+  // A[r][c] * frame[missing[c]] = syndromes[r], applying every row
+  // operation to the syndromes as well.
+  unsigned char A [FEC_MAX_PARITY][FEC_MAX_PARITY];
+  unsigned char *tmp;
+  unsigned char f;
+  int r,c,k,pivot;
+
+  if (numMissing > FEC_MAX_PARITY)
+    return -1;
+
+  for (r=0;r<numMissing;r++)
+    for (c=0;c<numMissing;c++)
+      A[r][c] = FEC_coef (parityIndex[r],missing[c]);
+
+  for (c=0;c<numMissing;c++)
+    {
+      // find a row with a nonzero entry in column c and move it up
+      for (pivot=c;pivot<numMissing && A[pivot][c]==0;pivot++)
+	;
+      if (pivot == numMissing)
+	return -1;
+      if (pivot != c)
+	{
+	  for (k=0;k<numMissing;k++)
+	    {
+	      f = A[c][k];
+	      A[c][k] = A[pivot][k];
+	      A[pivot][k] = f;
+	    }
+	  tmp = syndromes[c];
+	  syndromes[c] = syndromes[pivot];
+	  syndromes[pivot] = tmp;
+	}
+
+      // scale the pivot row so the pivot is 1
+      f = FEC_inv (A[c][c]);
+      if (f != 1)
+	{
+	  for (k=0;k<numMissing;k++)
+	    A[c][k] = FEC_mul (A[c][k],f);
+	  for (k=0;k<size;k++)
+	    syndromes[c][k] = FEC_mul (syndromes[c][k],f);
+	}
+
+      // eliminate column c from every other row
+      for (r=0;r<numMissing;r++)
+	{
+	  if (r == c || A[r][c] == 0)
+	    continue;
+	  f = A[r][c];
+	  for (k=0;k<numMissing;k++)
+	    A[r][k] ^= FEC_mul (A[c][k],f);
+	  FEC_addScaled (syndromes[r],syndromes[c],size,f);
+	}
+    }
+
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// FEC_buildTables
+//
+///////////////////////////////////////////////////////////////////////////////
+static void FEC_buildTables (void)
+{
+  unsigned int x = 1;
+  int i;
+
+  for (i=0;i<255;i++)
+    {
+      FEC_exp[i] = FEC_exp[i+255] = x;
+      FEC_log[x] = i;
+      x <<= 1;
+      if (x & 0x100)
+	x ^= FEC_POLY;
+    }
+  FEC_exp[510] = FEC_exp[511] = FEC_exp[0];
+  FEC_tablesBuilt = 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// FEC_mul
+//
+///////////////////////////////////////////////////////////////////////////////
+static unsigned char FEC_mul (unsigned char a, unsigned char b)
+{
+  if (a == 0 || b == 0)
+    return 0;
+  if (!FEC_tablesBuilt)
+    FEC_buildTables ();
+  return FEC_exp[FEC_log[a] + FEC_log[b]];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// FEC_inv
+//
+///////////////////////////////////////////////////////////////////////////////
+static unsigned char FEC_inv (unsigned char a)
+{
+  if (!FEC_tablesBuilt)
+    FEC_buildTables ();
+  return FEC_exp[255 - FEC_log[a]];
+}
@@ -0,0 +1,41 @@
+//
+// File: fec.h
+//
+// Author: Hamza Sultan Khan Niazi
+//
+// Description: Forward error correction over blocks of frames.  Parity
+// frames are Reed-Solomon style combinations over GF(2^8) of the frames in
+// a block: parity frame j is the sum over the block of alpha^(i*j) times
+// frame i.  Parity frame 0 is therefore the plain XOR of the block, and
+// any e lost frames can be rebuilt from e parity frames.
+//
+// The following functions are defined:
+//    FEC_coef (int parityIndex, int frameIndex)
+//    FEC_addScaled (unsigned char *dst, const unsigned char *src, int len,
+//                   unsigned char coef)
+//    FEC_solve (int numMissing, const int *missing, const int *parityIndex,
+//               unsigned char **syndromes, int size)
+//
+#ifndef _FEC_H
+#define _FEC_H
+
+// largest number of data frames and parity frames in a block
+#define FEC_MAX_BLOCK  128
+#define FEC_MAX_PARITY 8
+
+unsigned char FEC_coef (int parityIndex, int frameIndex);
+// returns the coefficient of frame frameIndex in parity frame parityIndex.
+
+void FEC_addScaled (unsigned char *dst, const unsigned char *src, int len,
+		    unsigned char coef);
+// adds coef times the len bytes at src into dst.
+
+int FEC_solve (int numMissing, const int *missing, const int *parityIndex,
+	       unsigned char **syndromes, int size);
+// rebuilds lost frames.  missing holds the block indices of the numMissing
+// lost frames, and for r < numMissing syndromes[r] holds parity frame
+// parityIndex[r] minus the contribution of every frame that did arrive.
+// On return syndromes[r] holds frame missing[r].  All buffers are size
+// bytes.  A negative return value means the frames can't be rebuilt from
+// these parity frames.
+#endif
@@ -0,0 +1,223 @@
+//
+// File: lz.c
+//
+// Author: Hamza Sultan Khan Niazi
+//
+// Description: Implementation of the compressor defined in lz.h.  Matches
+// are found through a hash table of the last position at which each
+// four byte string was seen, so compression is a single greedy pass.
+//
+#include <string.h>  // memcpy, memset
+#include <stdint.h>
+#include "lz.h"
+
+#define LZ_HASH_BITS 12
+#define LZ_HASH_SIZE (1 << LZ_HASH_BITS)
+#define LZ_MAX_OFFSET 0xffff
+
+// prototypes for local functions
+static unsigned int LZ_hash (const unsigned char *p);
+static int LZ_matchLength (const unsigned char *a, const unsigned char *b,
+			   int max);
+static int LZ_putCount (unsigned char *out, int op, int outMax, int count);
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// LZ_compress
+//
+///////////////////////////////////////////////////////////////////////////////
+int LZ_compress (const unsigned char *in, int inLen, unsigned char *out,
+		 int outMax)
+{
+  uint16_t table [LZ_HASH_SIZE];
+  unsigned int h;
+  int ip,anchor,ref,op,lit,len;
+
+  if (inLen < 0 || inLen > LZ_MAX_INPUT)
+    return -1;
+  memset (table,0,sizeof(table));
+
+  ip = anchor = op = 0;
+  while (ip + LZ_MIN_MATCH <= inLen)
+    {
+      // the last place these four bytes were seen, if anywhere
+      h = LZ_hash (in+ip);
+      ref = table[h];
+      table[h] = ip;
+      if (ref >= ip || ip - ref > LZ_MAX_OFFSET ||
+	  memcmp (in+ref,in+ip,LZ_MIN_MATCH) != 0)
+	{
+	  ip++;
+	  continue;
+	}
+      len = LZ_MIN_MATCH + LZ_matchLength (in+ref+LZ_MIN_MATCH,
+					   in+ip+LZ_MIN_MATCH,
+					   inLen - ip - LZ_MIN_MATCH);
+
+      // the token, then the literals since the last match
+      lit = ip - anchor;
+      if (op >= outMax)
+	return -1;
+      out[op++] = (lit < 15 ? lit : 15) << 4 |
+	(len - LZ_MIN_MATCH < 15 ? len - LZ_MIN_MATCH : 15);
+      if (lit >= 15 && (op = LZ_putCount (out,op,outMax,lit - 15)) < 0)
+	return -1;
+      if (op + lit + 2 > outMax)
+	return -1;
+      memcpy (out+op,in+anchor,lit);
+      op += lit;
+
+      // and the match
+      out[op++] = (ip - ref) >> 8;
+      out[op++] = (ip - ref) & 0xff;
+      if (len - LZ_MIN_MATCH >= 15 &&
+	  (op = LZ_putCount (out,op,outMax,len - LZ_MIN_MATCH - 15)) < 0)
+	return -1;
+
+      ip += len;
+      anchor = ip;
+    }
+
+  // whatever is left goes as literals
+  lit = inLen - anchor;
+  if (op >= outMax)
+    return -1;
+  out[op++] = (lit < 15 ? lit : 15) << 4;
+  if (lit >= 15 && (op = LZ_putCount (out,op,outMax,lit - 15)) < 0)
+    return -1;
+  if (op + lit > outMax)
+    return -1;
+  memcpy (out+op,in+anchor,lit);
+  return op + lit;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// LZ_decompress
+//
+///////////////////////////////////////////////////////////////////////////////
+int LZ_decompress (const unsigned char *in, int inLen, unsigned char *out,
+		   int outMax)
+{
+  int ip,op,lit,len,offset,b,i;
+
+  ip = op = 0;
+  while (ip < inLen)
+    {
+      // literals
+      lit = in[ip] >> 4;
+      len = (in[ip] & 0x0f) + LZ_MIN_MATCH;
+      ip++;
+      if (lit == 15)
+	do
+	  {
+	    if (ip >= inLen)
+	      return -1;
+	    lit += b = in[ip++];
+	  }
+	while (b == 255);
+      if (lit > inLen - ip || lit > outMax - op)
+	return -1;
+      memcpy (out+op,in+ip,lit);
+      ip += lit;
+      op += lit;
+
+      // the last sequence has no match
+      if (ip == inLen)
+	break;
+
+      if (ip + 2 > inLen)
+	return -1;
+      offset = (in[ip] << 8) | in[ip+1];
+      ip += 2;
+      if (offset == 0 || offset > op)
+	return -1;
+      if (len == 15 + LZ_MIN_MATCH)
+	do
+	  {
+	    if (ip >= inLen)
+	      return -1;
+	    len += b = in[ip++];
+	  }
+	while (b == 255);
+      if (len > outMax - op)
+	return -1;
+
+      // a match may overlap the bytes it produces, repeating them
+      if (offset >= len)
+	memcpy (out+op,out+op-offset,len);
+      else
+	for (i=0;i<len;i++)
+	  out[op+i] = out[op+i-offset];
+      op += len;
+    }
+
+  return op;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// LZ_hash
+//
+///////////////////////////////////////////////////////////////////////////////
+static unsigned int LZ_hash (const unsigned char *p)
+{
+  uint32_t v;
+
+  memcpy (&v,p,4);
+  return (v * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// LZ_matchLength
+//
+///////////////////////////////////////////////////////////////////////////////
+static int LZ_matchLength (const unsigned char *a, const unsigned char *b,
+			   int max)
+{
+  // the number of bytes, up to max, that a and b have in common, compared
+  // eight at a time
+  uint64_t x,y;
+  int n = 0;
+
+  while (n + 8 <= max)
+    {
+      memcpy (&x,a+n,8);
+      memcpy (&y,b+n,8);
+      if (x != y)
+	{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	  return n + __builtin_ctzll (x ^ y) / 8;
+#else
+	  return n + __builtin_clzll (x ^ y) / 8;
+#endif
+	}
+      n += 8;
+    }
+  while (n < max && a[n] == b[n])
+    n++;
+  return n;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// LZ_putCount
+//
+///////////////////////////////////////////////////////////////////////////////
+static int LZ_putCount (unsigned char *out, int op, int outMax, int count)
+{
+  // write the continuation of a length field.  Returns the new output
+  // position, or -1 if out is full.
+  while (count >= 255)
+    {
+      if (op >= outMax)
+	return -1;
+      out[op++] = 255;
+      count -= 255;
+    }
+  if (op >= outMax)
+    return -1;
+  out[op++] = count;
+  return op;
+}
@@ -0,0 +1,44 @@
+//
+// File: lz.h
+//
+// Author: Hamza Sultan Khan Niazi
+//
+// Description: A small, fast LZ77 compressor for frame payloads, in the
+// manner of LZ4.  Compressed data is a series of sequences, each a token
+// byte followed by a run of literal bytes and then a match, a copy of
+// bytes already produced:
+//    token       literal count (high four bits) and match length less
+//                LZ_MIN_MATCH (low four bits).  A field of 15 is continued
+//                in the bytes that follow, each added in, until one isn't
+//                255; the literal count's bytes come before the literals
+//                and the match length's after the offset.
+//    literals    copied as they are
+//    offset      2 bytes, most significant first: how far back the match
+//                starts
+// The last sequence has no match; the data ends after its literals.
+//
+// The following functions are defined:
+//    LZ_compress (const unsigned char *in, int inLen, unsigned char *out,
+//                 int outMax)
+//    LZ_decompress (const unsigned char *in, int inLen, unsigned char *out,
+//                   int outMax)
+//
+#ifndef _LZ_H
+#define _LZ_H
+
+// shortest match worth a sequence, and the most input compressed at once
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_INPUT 0xffff
+
+int LZ_compress (const unsigned char *in, int inLen, unsigned char *out,
+		 int outMax);
+// compresses the inLen bytes at in, at most LZ_MAX_INPUT, into out.
+// Returns the compressed length, or -1 if it would be more than outMax
+// bytes.
+
+int LZ_decompress (const unsigned char *in, int inLen, unsigned char *out,
+		   int outMax);
+// decompresses the inLen bytes at in into out.  Returns the decompressed
+// length, or -1 if the data is malformed or would take more than outMax
+// bytes.
+#endif
@@ -7,32 +7,104 @@
 #include <netdb.h>
 #include <stdlib.h>  // exit
 #include <ctype.h>   // isprint
+#include <unistd.h>  // getopt
+#include <string.h>  // strcmp
 #include "SWP.h"
 #include "unreliableSend.h"
 
-#define BUF_SIZE 1024
+#define XFER_SIZE (1024*1024)
 #define MAX_PENDING 5
 #define SERVER_PORT 50000
+
+// integrity policies that may be named on the command line
+static char *checkNames[] = {"none","crc16","crc32c","hash64"};
+
 int main (int argc, char *argv[]) {
-  char buf[BUF_SIZE];
-  int len;
+  char buf[SWP_MAX_PAYLOAD];
+  int len,received,expected;
+  int payloadSize=SWP_DEFAULT_PAYLOAD;
   int i,j;
   int port;
   int errorRate;
   int winSize;
+  struct SWP_stats stats;
+  int checkPolicy=SWP_CHECK_CRC16;
+  int stripes=1;
+  char *traceFile=0;
+  int compress=0;
+  int backend=SWP_BACKEND_SOCKETS;
+  int sharedMemory=1;
+  int opt,badUsage=0;
   
-  // get command line argument
-  if (argc == 4)
+  // get command line options and arguments
+  while ((opt = getopt(argc,argv,"s:c:m:S:t:zUN")) != -1)
+    switch (opt)
+      {
+      case 's':
+	US_SetSeed (strtoull(optarg,0,0));
+	break;
+      case 'c':
+	for (checkPolicy=0;checkPolicy<4;checkPolicy++)
+	  if (!strcmp(optarg,checkNames[checkPolicy]))
+	    break;
+	badUsage |= (checkPolicy==4);
+	break;
+      case 'm':
+	payloadSize = atoi(optarg);
+	break;
+      case 'S':
+	stripes = atoi(optarg);
+	break;
+      case 't':
+	traceFile = optarg;
+	break;
+      case 'z':
+	compress = 1;
+	break;
+      case 'U':
+	backend = SWP_BACKEND_URING;
+	break;
+      case 'N':
+	sharedMemory = 0;
+	break;
+      default:
+	badUsage = 1;
+      }
+  if (argc-optind == 3 && !badUsage)
     {
-      port = atoi(argv[1]);
-      winSize = atoi(argv[2]);
-      errorRate = atoi(argv[3]);
+      port = atoi(argv[optind]);
+      winSize = atoi(argv[optind+1]);
+      errorRate = atoi(argv[optind+2]);
     }
   else
     {
-      printf ("usage:receiver <serverPort> <RecvWinSize> <errorRate>\n");
+      printf ("usage:receiver [-s seed] [-c none|crc16|crc32c|hash64] [-m PayloadSize]\n"
+	      "               [-S Stripes] [-t TraceFile] [-z] [-U] [-N]\n"
+	      "               <serverPort> <RecvWinSize> <errorRate>\n");
       exit (1);
     }
+
+  // choose how frames are checked, and the largest payload we'll take
+  SWP_setIntegrity (checkPolicy);
+  if (SWP_setPayloadSize(payloadSize,0))
+    exit (1);
+
+  // listen on several ports if asked to
+  if (SWP_setStripes(stripes))
+    exit (1);
+
+  // agree to compressed frames if asked to
+  SWP_setCompression (compress);
+
+  // serve the sockets through io_uring if asked to, and if we can
+  SWP_setBackend (backend);
+
+  // keep to UDP on this host if asked to
+  SWP_setSharedMemory (sharedMemory);
+
+  // trace every frame if asked to
+  if (traceFile && SWP_setTrace(traceFile,65536))
+    exit (1);
   
   // intialize receiver
   if(SWP_recvInit(port,winSize)<0)
@@ -41,8 +113,9 @@ int main (int argc, char *argv[]) {
   // set failure probability for acks
   US_SetFailureProb (errorRate);
   
-  // read in 1MB of data from client
-  for (i=0;i<1024;i++)
+  // read in 1MB of data from client, in which each kilobyte is a
+  // different letter
+  for (i=0,received=0;received<XFER_SIZE;i++,received+=len)
     {
       // read in next packet
       SWP_recv (buf,&len);
@@ -51,25 +124,26 @@ int main (int argc, char *argv[]) {
 	printf ("Received packet %d\n",i);
       
       // verify that it is what we expect
-      if (len != BUF_SIZE)
+      if (len < 1 || len > XFER_SIZE-received)
 	{
-	  printf ("length error.  Expected %d, received %d.\n",BUF_SIZE,len);
+	  printf ("length error.  Expected at most %d, received %d.\n",
+		  XFER_SIZE-received,len);
 	  exit(1);
 	}
       
-      for (j=0;j<1024;j++)
-	if (buf[j] != ('A'+i%26))
+      for (j=0;j<len;j++)
+	if (buf[j] != (expected = 'A'+(received+j)/1024%26))
 	  {
 	    if (isprint(buf[j]))
 	      printf ("Data error.  Expected '%c'(%2x), received '%c' (%2x).",
-		      ('A'+i%26),('A'+i%26),buf[j],buf[j]);
+		      expected,expected,buf[j],buf[j]);
 	    else
 	      printf ("Data error.  Expected '%c'(%2x), received '%c' (%2x).",
-		      ('A'+i%26),('A'+i%26),' ',buf[j]&0xff);
+		      expected,expected,' ',buf[j]&0xff);
 	    
 	    printf (" Position=%d.\n",j);
 	    printf ("Rest of packet:\n");
-	    for (;j<1024;j++)
+	    for (;j<len;j++)
 	      {
 		if (j%8 == 0)
 		  printf("\n%4d:",j);
@@ -83,9 +157,19 @@ int main (int argc, char *argv[]) {
 	  }
     }
   
+  SWP_getStats (&stats);
+  printf ("%ld frames received, %ld rebuilt from parity, %ld bad.\n",
+	  stats.framesReceived,stats.framesRecoveredFEC,stats.badFrames);
+  if (stats.framesDecompressed)
+    printf ("%ld frames decompressed, %ld bytes from %ld in %ld usecs.\n",
+	    stats.framesDecompressed,stats.bytesBeforeCompression,
+	    stats.bytesAfterCompression,stats.decompressUsecs);
+  if (stats.ioUring)
+    printf ("Sockets were served through io_uring.\n");
+
   // delay a bit in case there are ACKs that still need sent back to client
   printf ("Please press enter.");
-  fgets (buf,BUF_SIZE,stdin);
+  fgets (buf,sizeof(buf),stdin);
   
 }
 
@@ -7,34 +7,163 @@
 #include <netdb.h>
 #include <sys/time.h>
 #include <stdlib.h>  // exit
+#include <unistd.h>  // getopt
+#include <string.h>  // strcmp
 #include "SWP.h"
 #include "unreliableSend.h"
 
 #define SERVER_PORT 50000
-#define BUF_SIZE 1024
+#define XFER_SIZE (1024*1024)
+
+// integrity policies that may be named on the command line
+static char *checkNames[] = {"none","crc16","crc32c","hash64"};
 
 int main (int argc, char *argv[]) {
   char *host;
-  char buf[BUF_SIZE];
+  char buf[SWP_MAX_PAYLOAD];
+  int msgSize=SWP_DEFAULT_PAYLOAD,probe=0;
+  int sent,len;
   int port;
   int errorRate;
   int winSize;
   int i,j;
   float xferTime;
   struct timeval startTime,stopTime;
+  struct SWP_stats stats;
+  int fecBlockSize=0,fecParity=0;
+  long paceRate=0;
+  int paceBurst=0;
+  int checkPolicy=SWP_CHECK_CRC16;
+  char *tokenFile=0;
+  FILE *fp;
+  struct SWP_resumeToken token;
+  int resumed;
+  int stripes=1;
+  int queueSize=0;
+  char *traceFile=0;
+  int compress=0;
+  int backend=SWP_BACKEND_SOCKETS;
+  int sharedMemory=1;
+  int opt,badUsage=0;
 
-  // get arguments from command line
-  if (argc==5) {
-    host = argv[1];
-    port = atoi(argv[2]);
-    winSize = atoi(argv[3]);
-    errorRate = atoi(argv[4]);
+  // get options and arguments from command line
+  while ((opt = getopt(argc,argv,"s:f:p:c:r:m:MS:Q:t:zUN")) != -1)
+    switch (opt) {
+    case 's':
+      US_SetSeed (strtoull(optarg,0,0));
+      break;
+    case 'f':
+      badUsage |= (sscanf(optarg,"%d,%d",&fecBlockSize,&fecParity) != 2);
+      break;
+    case 'p':
+      badUsage |= (sscanf(optarg,"%ld,%d",&paceRate,&paceBurst) != 2);
+      break;
+    case 'c':
+      for (checkPolicy=0;checkPolicy<4;checkPolicy++)
+	if (!strcmp(optarg,checkNames[checkPolicy]))
+	  break;
+      badUsage |= (checkPolicy==4);
+      break;
+    case 'r':
+      tokenFile = optarg;
+      break;
+    case 'm':
+      msgSize = atoi(optarg);
+      break;
+    case 'M':
+      probe = 1;
+      break;
+    case 'S':
+      stripes = atoi(optarg);
+      break;
+    case 'Q':
+      queueSize = atoi(optarg);
+      break;
+    case 't':
+      traceFile = optarg;
+      break;
+    case 'z':
+      compress = 1;
+      break;
+    case 'U':
+      backend = SWP_BACKEND_URING;
+      break;
+    case 'N':
+      sharedMemory = 0;
+      break;
+    default:
+      badUsage = 1;
+    }
+  if (argc-optind==4 && !badUsage) {
+    host = argv[optind];
+    port = atoi(argv[optind+1]);
+    winSize = atoi(argv[optind+2]);
+    errorRate = atoi(argv[optind+3]);
   }
   else {
-    printf("usage: sender <hostname> <ServerPort> <SendWinSize> <errorRate>\n");
+    printf("usage: sender [-s seed] [-f FECBlockSize,FECParity] [-p PaceRate,PaceBurst]\n"
+	   "              [-c none|crc16|crc32c|hash64] [-r TokenFile]\n"
+	   "              [-m PayloadSize] [-M] [-S Stripes] [-Q QueueSize]\n"
+	   "              [-t TraceFile] [-z] [-U] [-N]\n"
+	   "              <hostname> <ServerPort> <SendWinSize> <errorRate>\n");
+    exit (1);
+  }
+
+  // choose the payload size, and whether to probe the path for it
+  if (SWP_setPayloadSize(msgSize,probe)) {
+    printf("setPayloadSize Failed\n");
+    exit (1);
+  }
+
+  // choose how frames are checked
+  SWP_setIntegrity (checkPolicy);
+
+  // spread the session over several ports if asked to
+  if (SWP_setStripes(stripes)) {
+    printf("setStripes Failed\n");
+    exit (1);
+  }
+
+  // offer to compress frames if asked to
+  SWP_setCompression (compress);
+
+  // serve the sockets through io_uring if asked to, and if we can
+  SWP_setBackend (backend);
+
+  // keep to UDP on this host if asked to
+  SWP_setSharedMemory (sharedMemory);
+
+  // send through the send queue if asked to
+  if (queueSize && SWP_setSendQueue(queueSize)) {
+    printf("setSendQueue Failed\n");
     exit (1);
   }
 
+  // trace every frame if asked to
+  if (traceFile && SWP_setTrace(traceFile,65536)) {
+    printf("setTrace Failed\n");
+    exit (1);
+  }
+
+  // turn on forward error correction if asked to
+  if (fecBlockSize && SWP_setFEC(fecBlockSize,fecParity)) {
+    printf("setFEC Failed\n");
+    exit (1);
+  }
+
+  // pace transmissions if asked to
+  if (paceBurst && SWP_setPacing(paceRate,paceBurst)) {
+    printf("setPacing Failed\n");
+    exit (1);
+  }
+
+  // resume the last session if we kept its token
+  if (tokenFile && (fp = fopen(tokenFile,"rb"))) {
+    if (fread(&token,sizeof(token),1,fp) == 1)
+      SWP_setResumeToken (&token);
+    fclose (fp);
+  }
+
   // initialize stopwait send
   if(SWP_sendInit(host,port,winSize)){
     printf("sendInit Failed\n");
@@ -44,16 +173,17 @@ int main (int argc, char *argv[]) {
   // set failure probability of outgoing packets
   US_SetFailureProb (errorRate);
 
-  // send 1MB to server, keeping track of the time
+  // send 1MB to server, a payload at a time, keeping track of the time
   gettimeofday (&startTime,0);
-  for (i=0;i<1024;i++)
+  for (sent=0;sent<XFER_SIZE;sent+=len)
     {
-      // fill buffer
-      for (j=0;j<BUF_SIZE;j++)
-	buf[j] = 'A' + i%26;
+      // fill buffer; each kilobyte of the transfer is a different letter
+      len = XFER_SIZE-sent < msgSize ? XFER_SIZE-sent : msgSize;
+      for (j=0;j<len;j++)
+	buf[j] = 'A' + (sent+j)/1024%26;
 
       // send the buffer
-      SWP_send (buf,BUF_SIZE);
+      SWP_send (buf,len);
     }
 
   // wait for all messages to be sent
@@ -65,6 +195,34 @@ int main (int argc, char *argv[]) {
     (startTime.tv_sec+startTime.tv_usec*0.000001);
   printf ("The transfer took %6.3f seconds.\n",xferTime);
 
+  SWP_getStats (&stats);
+  printf ("%ld frames sent, %ld retransmitted, %ld parity frames sent.\n",
+	  stats.framesSent,stats.framesRetransmitted,stats.parityFramesSent);
+  printf ("Smoothed round trip time %ld usecs, payload %ld bytes.\n",
+	  stats.srttUsecs,stats.payloadSize);
+  if (stats.framesCompressed || stats.framesNotCompressed)
+    printf ("%ld frames compressed, %ld not; %ld bytes to %ld (%.1f%%) "
+	    "in %ld usecs.\n",
+	    stats.framesCompressed,stats.framesNotCompressed,
+	    stats.bytesBeforeCompression,stats.bytesAfterCompression,
+	    stats.bytesBeforeCompression ?
+	    100.0 * stats.bytesAfterCompression / stats.bytesBeforeCompression
+	    : 100.0,stats.compressUsecs);
+  if (stats.sharedMemory)
+    printf ("Frames went through shared memory.\n");
+  if (stats.ioUring)
+    printf ("Sockets were served through io_uring.\n");
+
+  // show what the handshake settled on, and keep the token for next time
+  resumed = SWP_getResumeToken (&token);
+  printf ("Session %s: window %d, payload %d, check %s, stripes %d.\n",
+	  resumed ? "resumed" : "negotiated",token.windowSize,
+	  token.payloadSize,checkNames[token.checkPolicy],token.stripes);
+  if (tokenFile && (fp = fopen(tokenFile,"wb"))) {
+    fwrite (&token,sizeof(token),1,fp);
+    fclose (fp);
+  }
+
 }
 
     
@@ -0,0 +1,347 @@
+//
+// File: shm.c
+//
+// Author: Hamza Sultan Khan Niazi
+//
+// Description: Implementation of the shared memory channels defined in
+// shm.h.  The object holds a header, with the pids of the two ends, and
+// the two rings.  Head and tail are counts of the datagrams ever
+// published and released, so the ring is empty when they're equal and
+// full when they're SHM_SLOTS apart; each lives on its own cache line.
+// The consumer sets waiting before it looks at the head for the last
+// time and sleeps, and the producer looks at waiting after it has moved
+// the head, so between them one always sees the other.  A stop doesn't
+// move the head, so a consumer sleeps for at most SHM_STOP_NSECS at a
+// time before looking for one.
+//
+#include <sys/types.h>
+#include <sys/mman.h>     // mmap, shm_open
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <fcntl.h>
+#include <signal.h>       // kill
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>       // malloc
+#include <string.h>       // strncpy
+#include <time.h>         // struct timespec
+#include <unistd.h>       // ftruncate, getpid
+#include <stdatomic.h>
+#include "shm.h"
+
+#define SHM_MAGIC 0x53574d31    // "SWM1"
+#define SHM_SPINS 2000          // looks at an empty ring before sleeping,
+				// given another CPU to fill it
+#define SHM_NAME_SIZE 64
+#define SHM_STOP_NSECS 100000000  // longest a stop may go unseen
+
+struct SHM_slot {
+  uint32_t length;
+  uint32_t pad;
+  unsigned char data [SHM_MAX_DATAGRAM];
+};
+
+struct SHM_ring {
+  _Atomic uint32_t head;       // datagrams published; the futex word
+  char pad1 [60];
+  _Atomic uint32_t tail;       // datagrams released
+  _Atomic uint32_t waiting;    // true iff the consumer may be asleep
+  char pad2 [56];
+  struct SHM_slot slot [SHM_SLOTS];
+};
+
+// ring[0] carries datagrams to the creator, ring[1] to the attached end
+struct SHM_shared {
+  uint32_t magic;
+  _Atomic pid_t creator;
+  _Atomic pid_t attached;
+  struct sockaddr_in addr;     // the attached end's address
+  char pad [32];
+  struct SHM_ring ring [2];
+};
+
+struct SHM_channel {
+  struct SHM_shared *shared;
+  struct SHM_ring *in, *out;
+  char name [SHM_NAME_SIZE];
+  atomic_int stopped;          // true once SHM_stop has been called
+};
+
+// prototypes for local functions
+static struct SHM_channel *SHM_map (const char *name, int fd, int end);
+static int SHM_alive (pid_t pid);
+static void SHM_futex (_Atomic uint32_t *word, int op, uint32_t value,
+		       const struct timespec *timeout);
+
+// times to look at an empty ring before sleeping.  With one CPU the
+// producer can't run while we spin.
+static int SHM_spins = -1;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SHM_create
+//
+///////////////////////////////////////////////////////////////////////////////
+struct SHM_channel *SHM_create (const char *name)
+{
+  struct SHM_channel *channel;
+  int fd;
+
+  // a fresh object, so nothing attached to an old one can reach us
+  shm_unlink (name);
+  if ((fd = shm_open (name,O_RDWR|O_CREAT|O_EXCL,0600)) < 0)
+    return 0;
+  if (ftruncate (fd,sizeof(struct SHM_shared)) < 0 ||
+      !(channel = SHM_map (name,fd,0)))
+    {
+      close (fd);
+      shm_unlink (name);
+      return 0;
+    }
+  close (fd);
+
+  // the object starts out zeroed, so both rings are empty.  The magic
+  // number goes in last, once the rest is there to be seen.
+  atomic_store (&channel->shared->creator,getpid());
+  atomic_thread_fence (memory_order_release);
+  channel->shared->magic = SHM_MAGIC;
+  return channel;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SHM_attach
+//
+///////////////////////////////////////////////////////////////////////////////
+struct SHM_channel *SHM_attach (const char *name,
+				const struct sockaddr_in *addr)
+{
+  struct SHM_channel *channel;
+  struct SHM_shared *shared;
+  struct stat st;
+  pid_t attached;
+  int fd;
+
+  if ((fd = shm_open (name,O_RDWR,0)) < 0)
+    return 0;
+  if (fstat (fd,&st) < 0 || st.st_size != sizeof(struct SHM_shared) ||
+      !(channel = SHM_map (name,fd,1)))
+    {
+      close (fd);
+      return 0;
+    }
+  close (fd);
+  shared = channel->shared;
+
+  // the creator must still be there, and no one else attached.  The slot
+  // of a process that has gone may be taken over.
+  atomic_thread_fence (memory_order_acquire);
+  attached = atomic_load (&shared->attached);
+  if (shared->magic != SHM_MAGIC || !SHM_alive (shared->creator) ||
+      (attached != 0 && attached != getpid() && SHM_alive (attached)) ||
+      !atomic_compare_exchange_strong (&shared->attached,&attached,getpid()))
+    {
+      munmap (shared,sizeof(*shared));
+      free (channel);
+      return 0;
+    }
+  shared->addr = *addr;
+
+  // whatever was sent to whoever was attached before isn't for us
+  atomic_store (&channel->in->tail,atomic_load (&channel->in->head));
+  return channel;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SHM_remove
+//
+///////////////////////////////////////////////////////////////////////////////
+void SHM_remove (struct SHM_channel *channel)
+{
+  shm_unlink (channel->name);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SHM_stop
+//
+///////////////////////////////////////////////////////////////////////////////
+void SHM_stop (struct SHM_channel *channel)
+{
+  atomic_store (&channel->stopped,1);
+  SHM_futex (&channel->in->head,FUTEX_WAKE,1,0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SHM_close
+//
+///////////////////////////////////////////////////////////////////////////////
+void SHM_close (struct SHM_channel *channel)
+{
+  munmap (channel->shared,sizeof(*channel->shared));
+  free (channel);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SHM_reserve
+//
+///////////////////////////////////////////////////////////////////////////////
+unsigned char *SHM_reserve (struct SHM_channel *channel, int length)
+{
+  struct SHM_ring *ring = channel->out;
+  uint32_t head;
+
+  head = atomic_load_explicit (&ring->head,memory_order_relaxed);
+  if (length < 0 || length > SHM_MAX_DATAGRAM ||
+      head - atomic_load_explicit (&ring->tail,memory_order_acquire) >=
+      SHM_SLOTS)
+    return 0;
+  return ring->slot[head & (SHM_SLOTS - 1)].data;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SHM_commit
+//
+///////////////////////////////////////////////////////////////////////////////
+void SHM_commit (struct SHM_channel *channel, int length)
+{
+  struct SHM_ring *ring = channel->out;
+  uint32_t head;
+
+  head = atomic_load_explicit (&ring->head,memory_order_relaxed);
+  ring->slot[head & (SHM_SLOTS - 1)].length = length;
+  atomic_store (&ring->head,head + 1);
+
+  // the consumer only needs the system call if it may be asleep
+  if (atomic_load (&ring->waiting))
+    SHM_futex (&ring->head,FUTEX_WAKE,1,0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SHM_next
+//
+///////////////////////////////////////////////////////////////////////////////
+unsigned char *SHM_next (struct SHM_channel *channel, int *length)
+{
+  struct SHM_ring *ring = channel->in;
+  struct SHM_slot *slot;
+  struct timespec timeout;
+  uint32_t tail;
+  int spins = 0;
+
+  if (SHM_spins < 0)
+    SHM_spins = sysconf (_SC_NPROCESSORS_ONLN) > 1 ? SHM_SPINS : 0;
+
+  tail = atomic_load_explicit (&ring->tail,memory_order_relaxed);
+  while (atomic_load_explicit (&ring->head,memory_order_acquire) == tail)
+    {
+      if (atomic_load_explicit (&channel->stopped,memory_order_relaxed))
+	return 0;
+      if (++spins < SHM_spins)
+	continue;
+
+      // the producer looks at waiting after moving the head, so either we
+      // see the new head here or it sees waiting and wakes us
+      atomic_store (&ring->waiting,1);
+      timeout.tv_sec = 0;
+      timeout.tv_nsec = SHM_STOP_NSECS;
+      if (atomic_load (&ring->head) == tail)
+	SHM_futex (&ring->head,FUTEX_WAIT,tail,&timeout);
+      atomic_store (&ring->waiting,0);
+      spins = 0;
+    }
+
+  slot = &ring->slot[tail & (SHM_SLOTS - 1)];
+  *length = slot->length;
+  if (*length > SHM_MAX_DATAGRAM)
+    *length = SHM_MAX_DATAGRAM;
+  return slot->data;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SHM_release
+//
+///////////////////////////////////////////////////////////////////////////////
+void SHM_release (struct SHM_channel *channel)
+{
+  struct SHM_ring *ring = channel->in;
+
+  atomic_store_explicit (&ring->tail,
+			 atomic_load_explicit (&ring->tail,
+					       memory_order_relaxed) + 1,
+			 memory_order_release);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SHM_peer
+//
+///////////////////////////////////////////////////////////////////////////////
+void SHM_peer (struct SHM_channel *channel, struct sockaddr_in *addr)
+{
+  *addr = channel->shared->addr;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SHM_map
+//
+///////////////////////////////////////////////////////////////////////////////
+static struct SHM_channel *SHM_map (const char *name, int fd, int end)
+{
+  // map the object open on fd as the given end of a channel: 0 for the
+  // creator, 1 for the process attached
+  struct SHM_channel *channel;
+  void *p;
+
+  if (!(channel = malloc (sizeof(*channel))))
+    return 0;
+  p = mmap (0,sizeof(struct SHM_shared),PROT_READ|PROT_WRITE,MAP_SHARED,
+	    fd,0);
+  if (p == MAP_FAILED)
+    {
+      free (channel);
+      return 0;
+    }
+
+  channel->shared = p;
+  channel->in = &channel->shared->ring[end];
+  channel->out = &channel->shared->ring[1 - end];
+  strncpy (channel->name,name,SHM_NAME_SIZE - 1);
+  channel->name[SHM_NAME_SIZE - 1] = 0;
+  atomic_init (&channel->stopped,0);
+  return channel;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SHM_alive
+//
+///////////////////////////////////////////////////////////////////////////////
+static int SHM_alive (pid_t pid)
+{
+  // true iff process pid exists, whether or not we could signal it
+  return pid > 0 && (kill (pid,0) == 0 || errno == EPERM);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SHM_futex
+//
+///////////////////////////////////////////////////////////////////////////////
+static void SHM_futex (_Atomic uint32_t *word, int op, uint32_t value,
+		       const struct timespec *timeout)
+{
+  // wait on, or wake a process waiting on, a futex shared between
+  // processes.  A wait returns at once if the word is no longer value,
+  // and may return early on a signal or once timeout, if not null, has
+  // passed; the caller looks again either way.
+  syscall (SYS_futex,(uint32_t *)word,op,value,timeout,0,0);
+}
@@ -0,0 +1,85 @@
+//
+// File: shm.h
+//
+// Author: Hamza Sultan Khan Niazi
+//
+// Description: Datagram channels between two processes on the same host,
+// through a shared memory object.  One process creates a channel under a
+// name, and one other at a time attaches to it by that name.  A channel is
+// a pair of rings, one each way, of SHM_SLOTS slots, each holding one
+// datagram of up to SHM_MAX_DATAGRAM bytes.  Each ring has one producer
+// and one consumer: a datagram is written into the next free slot and
+// published by moving the ring's head on, and the consumer reads it in
+// place and gives the slot back by moving the tail on.  A consumer with
+// nothing to read spins briefly, then sleeps on a futex on the head, and
+// the producer makes the system call to wake it only when it sleeps.  As
+// with UDP, a datagram that finds its ring full is dropped.
+//
+// The following functions are defined:
+//    SHM_create (const char *name)
+//    SHM_attach (const char *name, const struct sockaddr_in *addr)
+//    SHM_remove (struct SHM_channel *channel)
+//    SHM_stop (struct SHM_channel *channel)
+//    SHM_close (struct SHM_channel *channel)
+//    SHM_reserve (struct SHM_channel *channel, int length)
+//    SHM_commit (struct SHM_channel *channel, int length)
+//    SHM_next (struct SHM_channel *channel, int *length)
+//    SHM_release (struct SHM_channel *channel)
+//    SHM_peer (struct SHM_channel *channel, struct sockaddr_in *addr)
+//
+#ifndef _SHM_H
+#define _SHM_H
+
+#include <netinet/in.h>  // struct sockaddr_in
+
+// slots in each ring, a power of two, and the biggest datagram a slot
+// holds, a multiple of 8 so that every datagram starts 8 byte aligned
+#define SHM_SLOTS 256
+#define SHM_MAX_DATAGRAM 9000
+
+struct SHM_channel;
+
+struct SHM_channel *SHM_create (const char *name);
+// creates a channel under name, which is as for shm_open, replacing any
+// left behind by a process that has gone.  Returns the creating end, or
+// null if shared memory can't be had.
+
+struct SHM_channel *SHM_attach (const char *name,
+				const struct sockaddr_in *addr);
+// attaches to the channel created under name, as the address addr, unless
+// its creator has gone or another live process is attached to it.
+// Returns the attached end, or null if the channel can't be used.
+
+void SHM_remove (struct SHM_channel *channel);
+// removes the name of a channel created with SHM_create, so that no one
+// else can attach to it.  Those attached keep it until they exit.
+
+void SHM_stop (struct SHM_channel *channel);
+// makes the thread waiting in SHM_next at this end, and every later call
+// to it, return null.
+
+void SHM_close (struct SHM_channel *channel);
+// lets go of this end of a channel.  Nothing may use it afterwards.
+
+unsigned char *SHM_reserve (struct SHM_channel *channel, int length);
+// returns the slot that the next length byte datagram sent from this end
+// of the channel is to be written into, or null if the ring is full or
+// length is more than SHM_MAX_DATAGRAM.  Only one thread at a time may
+// send from an end.
+
+void SHM_commit (struct SHM_channel *channel, int length);
+// sends the length byte datagram written into the slot last reserved.
+
+unsigned char *SHM_next (struct SHM_channel *channel, int *length);
+// waits for the next datagram to come in at this end of the channel, and
+// returns it in place, setting length to its length.  It stays there
+// until released.  Returns null once the end has been stopped.  Only one
+// thread at a time may receive at an end.
+
+void SHM_release (struct SHM_channel *channel);
+// gives the slot of the datagram last returned by SHM_next back to the
+// sender.
+
+void SHM_peer (struct SHM_channel *channel, struct sockaddr_in *addr);
+// copies the address the process attached to a channel gave, into addr.
+#endif
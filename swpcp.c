@@ -0,0 +1,396 @@
+//
+// File: swpcp.c
+//
+// Author: Hamza Sultan Khan Niazi
+//
+// Description: Copies a file from one host to another over SWP.
+//
+//    swpcp [options] <file> <hostname> <port>      sends file
+//    swpcp [options] -l <port> <file>              receives into file
+//
+// The sender maps the file into memory and hands it to SWP_sendNoCopy a
+// chunk at a time, so frames are sent and resent straight from the page
+// cache without being staged in the send buffer.  The transfer starts with
+// a header giving the file size and ends with a trailer holding the
+// CRC-32C of the whole file.
+//
+// The receiver sizes the destination file up front, maps it and has each
+// message copied by SWP_recv straight to its offset in the mapping.  SWP
+// delivers in order through its bounded reorder buffer, so the offset is
+// just the number of bytes received so far, and nothing else is held in
+// memory however big the file is.  The check value is computed as the data
+// arrives and compared with the trailer.
+//
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>    // nanosleep
+#include <stdlib.h>  // exit
+#include <unistd.h>  // getopt
+#include <string.h>  // strcmp
+#include "SWP.h"
+#include "checksum.h"
+#include "unreliableSend.h"
+
+// the header starts with this magic number, which names the version
+#define SWPCP_MAGIC "SWPCP1\0\0"
+#define SWPCP_MAGIC_SIZE 8
+#define SWPCP_HEADER_SIZE (SWPCP_MAGIC_SIZE + 8)
+#define SWPCP_TRAILER_SIZE 4
+
+// bytes handed to SWP at a time, and checksummed just before
+#define SWPCP_CHUNK (1024*1024)
+
+// seconds the receiver stays around to answer resent frames once the file
+// is in, in case its last acks were lost
+#define SWPCP_LINGER 2
+
+// integrity policies that may be named on the command line
+static char *checkNames[] = {"none","crc16","crc32c","hash64"};
+
+// prototypes for local functions
+static int sendFile (char *fileName, char *host, int port);
+static int recvFile (char *fileName);
+static void recvSmall (unsigned char *buf, int size);
+static void report (long long bytes, struct timeval *startTime);
+
+int main (int argc, char *argv[]) {
+  int winSize=32,errorRate=0;
+  int payloadSize=SWP_DEFAULT_PAYLOAD,probe=0;
+  int fecBlockSize=0,fecParity=0;
+  long paceRate=0;
+  int paceBurst=0;
+  int checkPolicy=SWP_CHECK_CRC32C;
+  int listenPort=0;
+  int stripes=1;
+  int compress=0;
+  int backend=SWP_BACKEND_SOCKETS;
+  int sharedMemory=1;
+  int opt,badUsage=0;
+
+  // get options and arguments from command line
+  while ((opt = getopt(argc,argv,"l:w:e:s:f:p:c:m:MS:zUN")) != -1)
+    switch (opt) {
+    case 'l':
+      listenPort = atoi(optarg);
+      break;
+    case 'w':
+      winSize = atoi(optarg);
+      break;
+    case 'e':
+      errorRate = atoi(optarg);
+      break;
+    case 's':
+      US_SetSeed (strtoull(optarg,0,0));
+      break;
+    case 'f':
+      badUsage |= (sscanf(optarg,"%d,%d",&fecBlockSize,&fecParity) != 2);
+      break;
+    case 'p':
+      badUsage |= (sscanf(optarg,"%ld,%d",&paceRate,&paceBurst) != 2);
+      break;
+    case 'c':
+      for (checkPolicy=0;checkPolicy<4;checkPolicy++)
+	if (!strcmp(optarg,checkNames[checkPolicy]))
+	  break;
+      badUsage |= (checkPolicy==4);
+      break;
+    case 'm':
+      payloadSize = atoi(optarg);
+      break;
+    case 'M':
+      probe = 1;
+      break;
+    case 'S':
+      stripes = atoi(optarg);
+      break;
+    case 'z':
+      compress = 1;
+      break;
+    case 'U':
+      backend = SWP_BACKEND_URING;
+      break;
+    case 'N':
+      sharedMemory = 0;
+      break;
+    default:
+      badUsage = 1;
+    }
+  if (badUsage || argc-optind != (listenPort ? 1 : 3)) {
+    printf("usage: swpcp [-w WinSize] [-e errorRate] [-s seed] [-f FECBlockSize,FECParity]\n"
+	   "             [-p PaceRate,PaceBurst] [-c none|crc16|crc32c|hash64]\n"
+	   "             [-m PayloadSize] [-M] [-S Stripes] [-z] [-U] [-N]\n"
+	   "             <file> <hostname> <port>\n"
+	   "       swpcp [-w WinSize] [-e errorRate] [-s seed] [-c none|crc16|crc32c|hash64]\n"
+	   "             [-m PayloadSize] [-S Stripes] [-z] [-U] [-N] -l <port> <file>\n");
+    exit (1);
+  }
+
+  // session parameters, as for sender and receiver
+  SWP_setIntegrity (checkPolicy);
+  if (SWP_setPayloadSize(payloadSize,probe && !listenPort))
+    exit (1);
+  if (SWP_setStripes(stripes))
+    exit (1);
+  SWP_setCompression (compress);
+  SWP_setBackend (backend);
+  SWP_setSharedMemory (sharedMemory);
+  if (fecBlockSize && SWP_setFEC(fecBlockSize,fecParity)) {
+    printf("setFEC Failed\n");
+    exit (1);
+  }
+  if (paceBurst && SWP_setPacing(paceRate,paceBurst)) {
+    printf("setPacing Failed\n");
+    exit (1);
+  }
+
+  if (listenPort)
+    {
+      if (SWP_recvInit(listenPort,winSize) < 0) {
+	printf ("recvInit Failed\n");
+	exit (1);
+      }
+      US_SetFailureProb (errorRate);
+      return recvFile (argv[optind]);
+    }
+
+  if (SWP_sendInit(argv[optind+1],atoi(argv[optind+2]),winSize)) {
+    printf("sendInit Failed\n");
+    exit (1);
+  }
+  US_SetFailureProb (errorRate);
+  return sendFile (argv[optind],argv[optind+1],atoi(argv[optind+2]));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// sendFile
+//
+///////////////////////////////////////////////////////////////////////////////
+static int sendFile (char *fileName, char *host, int port)
+{
+  unsigned char header[SWPCP_HEADER_SIZE];
+  unsigned char trailer[SWPCP_TRAILER_SIZE];
+  struct CK_state st;
+  struct timeval startTime;
+  struct stat sb;
+  unsigned long long check;
+  unsigned char *map=0;
+  long long size,offset;
+  int fd,len,i;
+
+  if ((fd = open(fileName,O_RDONLY)) < 0 || fstat(fd,&sb) < 0) {
+    perror (fileName);
+    return 1;
+  }
+  size = sb.st_size;
+
+  // the mapping stays until SWP_flush returns, since frames may be resent
+  // from any part of it until then
+  if (size > 0)
+    {
+      map = mmap (0,size,PROT_READ,MAP_PRIVATE,fd,0);
+      if (map == MAP_FAILED) {
+	perror ("swpcp: mmap");
+	return 1;
+      }
+      madvise (map,size,MADV_SEQUENTIAL);
+    }
+
+  gettimeofday (&startTime,0);
+
+  // the header: magic number, then the file size most significant byte
+  // first
+  memcpy (header,SWPCP_MAGIC,SWPCP_MAGIC_SIZE);
+  for (i=0;i<8;i++)
+    header[SWPCP_MAGIC_SIZE+i] = size >> (56 - 8*i);
+  SWP_send ((char *)header,SWPCP_HEADER_SIZE);
+
+  // then the file itself, checksummed a chunk at a time just before it
+  // goes, while it's in the cache
+  CK_begin (&st,CK_CRC32C);
+  for (offset=0;offset<size;offset+=len)
+    {
+      len = size-offset < SWPCP_CHUNK ? size-offset : SWPCP_CHUNK;
+      CK_update (&st,map+offset,len);
+      SWP_sendNoCopy ((char *)map+offset,len);
+    }
+
+  // and the check value
+  check = CK_end (&st);
+  for (i=0;i<SWPCP_TRAILER_SIZE;i++)
+    trailer[i] = check >> (24 - 8*i);
+  SWP_send ((char *)trailer,SWPCP_TRAILER_SIZE);
+
+  SWP_flush ();
+  report (size,&startTime);
+  printf ("Sent %s to %s:%d, CRC-32C %08llx.\n",fileName,host,port,check);
+
+  if (map)
+    munmap (map,size);
+  close (fd);
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// recvFile
+//
+///////////////////////////////////////////////////////////////////////////////
+static int recvFile (char *fileName)
+{
+  unsigned char header[SWPCP_HEADER_SIZE];
+  unsigned char trailer[SWPCP_TRAILER_SIZE];
+  char buf[SWP_MAX_PAYLOAD];
+  struct CK_state st;
+  struct timeval startTime;
+  struct timespec linger;
+  unsigned long long check,sentCheck;
+  unsigned char *map=0;
+  long long size,offset;
+  int fd,len,i,err;
+
+  // the header tells us how much is coming
+  recvSmall (header,SWPCP_HEADER_SIZE);
+  gettimeofday (&startTime,0);
+  if (memcmp(header,SWPCP_MAGIC,SWPCP_MAGIC_SIZE)) {
+    printf ("swpcp: not an swpcp transfer\n");
+    return 1;
+  }
+  size = 0;
+  for (i=0;i<8;i++)
+    size = (size << 8) | header[SWPCP_MAGIC_SIZE+i];
+
+  // make the whole destination file now, so that running out of space
+  // shows up before the transfer rather than as a fault in the middle of
+  // it, then map it
+  if ((fd = open(fileName,O_RDWR|O_CREAT|O_TRUNC,0666)) < 0) {
+    perror (fileName);
+    return 1;
+  }
+  if (size > 0)
+    {
+      if ((err = posix_fallocate(fd,0,size)) != 0 &&
+	  (err != EOPNOTSUPP || ftruncate(fd,size) < 0)) {
+	printf ("swpcp: can't make %s %lld bytes long: %s\n",
+		fileName,size,strerror(err));
+	return 1;
+      }
+      map = mmap (0,size,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+      if (map == MAP_FAILED) {
+	perror ("swpcp: mmap");
+	return 1;
+      }
+      madvise (map,size,MADV_SEQUENTIAL);
+    }
+
+  // take each message straight into place.  Near the end there may not be
+  // room in the mapping for the biggest message, so the last few go
+  // through buf.
+  CK_begin (&st,CK_CRC32C);
+  for (offset=0;offset<size;offset+=len)
+    {
+      if (size-offset >= SWP_MAX_PAYLOAD)
+	SWP_recv ((char *)map+offset,&len);
+      else
+	{
+	  SWP_recv (buf,&len);
+	  if (len > size-offset) {
+	    printf ("swpcp: %d bytes received with %lld to go\n",
+		    len,size-offset);
+	    return 1;
+	  }
+	  memcpy (map+offset,buf,len);
+	}
+      CK_update (&st,map+offset,len);
+    }
+
+  // compare check values
+  recvSmall (trailer,SWPCP_TRAILER_SIZE);
+  check = CK_end (&st);
+  sentCheck = 0;
+  for (i=0;i<SWPCP_TRAILER_SIZE;i++)
+    sentCheck = (sentCheck << 8) | trailer[i];
+
+  report (size,&startTime);
+  if (map)
+    munmap (map,size);
+  close (fd);
+  if (check != sentCheck) {
+    printf ("Checksum mismatch: sent %08llx, received %08llx.\n",
+	    sentCheck,check);
+    return 1;
+  }
+  printf ("Received %s, CRC-32C %08llx OK.\n",fileName,check);
+
+  // stay around for a while in case there are ACKs that still need to be
+  // sent back; the sleep is cut short by every SIGIO
+  linger.tv_sec = SWPCP_LINGER;
+  linger.tv_nsec = 0;
+  while (nanosleep(&linger,&linger) < 0 && errno == EINTR)
+    ;
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// recvSmall
+//
+///////////////////////////////////////////////////////////////////////////////
+static void recvSmall (unsigned char *buf, int size)
+{
+  // receive a header or trailer of size bytes, which arrives in more than
+  // one message if the payload size is tiny
+  char msg[SWP_MAX_PAYLOAD];
+  int got,len;
+
+  for (got=0;got<size;got+=len)
+    {
+      SWP_recv (msg,&len);
+      if (len > size-got) {
+	printf ("swpcp: unexpected %d byte message\n",len);
+	exit (1);
+      }
+      memcpy (buf+got,msg,len);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// report
+//
+///////////////////////////////////////////////////////////////////////////////
+static void report (long long bytes, struct timeval *startTime)
+{
+  struct timeval stopTime;
+  struct SWP_stats stats;
+  float xferTime;
+
+  gettimeofday (&stopTime,0);
+  xferTime = (stopTime.tv_sec+stopTime.tv_usec*0.000001) -
+    (startTime->tv_sec+startTime->tv_usec*0.000001);
+  printf ("%lld bytes in %6.3f seconds, %.1f MB/s.\n",bytes,xferTime,
+	  xferTime > 0 ? bytes/xferTime/1e6 : 0.0);
+
+  SWP_getStats (&stats);
+  printf ("%ld frames sent, %ld retransmitted, %ld parity frames sent.\n",
+	  stats.framesSent,stats.framesRetransmitted,stats.parityFramesSent);
+  printf ("%ld frames received, %ld rebuilt from parity, %ld bad.\n",
+	  stats.framesReceived,stats.framesRecoveredFEC,stats.badFrames);
+  printf ("Payload %ld bytes.\n",stats.payloadSize);
+  if (stats.framesCompressed || stats.framesDecompressed)
+    printf ("Compressed %ld bytes to %ld (%.1f%%), %ld usecs compressing, "
+	    "%ld decompressing.\n",
+	    stats.bytesBeforeCompression,stats.bytesAfterCompression,
+	    100.0 * stats.bytesAfterCompression / stats.bytesBeforeCompression,
+	    stats.compressUsecs,stats.decompressUsecs);
+  if (stats.ioUring)
+    printf ("Sockets were served through io_uring.\n");
+}
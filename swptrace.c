@@ -0,0 +1,277 @@
+//
+// File: swptrace.c
+//
+// Author: Hamza Sultan Khan Niazi
+//
+// Description: Breaks down where the time of each frame went, from the
+// traces written by SWP_setTrace.
+//
+//    swptrace <trace file> ...
+//
+// The traces of both ends of a session are merged in time order, so the
+// two ends' clocks should agree; on one host they do.  Sequence numbers
+// are unwrapped as they go by, and for every data frame the time between
+// successive events is taken as one stage:
+//    window    handed to SWP_send until first sent: waiting for room in
+//              the window, for the pacer or behind the send queue
+//    send      sent until the kernel stamped it leaving the socket, for
+//              each transmission
+//    network   last sent before it arrived until the kernel stamped it
+//              coming in at the receiver
+//    receive   arrived until SWP_recv handed it over: waiting in the
+//              reorder buffer for frames before it, or for the application
+//    ack       first sent until acked, for frames sent only once
+//    recovery  first sent until it arrived, for frames that were resent
+//    total     handed to SWP_send until handed over by SWP_recv
+// and the spread of each stage over the frames is printed.
+//
+#include <stdio.h>
+#include <stdlib.h>  // exit, qsort
+#include <string.h>  // memset
+#include "trace.h"
+
+// the stages
+enum {ST_WINDOW, ST_SEND, ST_NETWORK, ST_RECEIVE, ST_ACK, ST_RECOVERY,
+      ST_TOTAL, ST_NUM};
+static char *stageNames[] = {"window","send","network","receive","ack",
+			     "recovery","total"};
+
+static char *typeNames[] = {"enqueue","transmit","retransmit","tx kernel",
+			    "ack","arrive","deliver"};
+
+// what we know of a frame; times are 0 until seen
+struct frame {
+  long long enqueued;
+  long long sent;        // first sent
+  long long lastSent;    // last sent, or stamped leaving, so far
+  long long unstamped;   // last sent, if not yet stamped leaving
+  long long arrived;
+  long long delivered;
+  long long acked;
+  int resent;
+};
+
+// prototypes for local functions
+static int byTime (const void *a, const void *b);
+static int byValue (const void *a, const void *b);
+static void stage (int which, long long from, long long to);
+static void report (int which);
+
+static long long *samples [ST_NUM];
+static int numSamples [ST_NUM];
+
+int main (int argc, char *argv[]) {
+  struct TR_event *events,*more;
+  struct frame *frames,*f;
+  long long *seqs;
+  long long last,lo,hi,acked;
+  int count[TR_NUM_TYPES],kernel[TR_NUM_TYPES];
+  int numEvents,n,numFrames,numResent,i,d;
+
+  if (argc < 2) {
+    printf("usage: swptrace <trace file> ...\n");
+    exit (1);
+  }
+
+  // read every trace and put the events in time order
+  events = 0;
+  numEvents = 0;
+  for (i=1;i<argc;i++) {
+    if ((n = TR_load(argv[i],&more)) < 0)
+      exit (1);
+    events = realloc(events,(numEvents + n + 1) * sizeof(*events));
+    if (!events) {
+      printf("out of memory\n");
+      exit (1);
+    }
+    memcpy (events+numEvents,more,n * sizeof(*events));
+    numEvents += n;
+    free (more);
+  }
+  if (numEvents == 0) {
+    printf("no events\n");
+    exit (1);
+  }
+  qsort (events,numEvents,sizeof(*events),byTime);
+
+  // unwrap the 16 bit sequence numbers: each is taken to be the one
+  // nearest the last
+  seqs = malloc(numEvents * sizeof(*seqs));
+  if (!seqs) {
+    printf("out of memory\n");
+    exit (1);
+  }
+  last = lo = hi = events[0].seq;
+  memset (count,0,sizeof(count));
+  memset (kernel,0,sizeof(kernel));
+  for (i=0;i<numEvents;i++) {
+    d = (events[i].seq - last) & 0xffff;
+    if (d >= 0x8000)
+      d -= 0x10000;
+    seqs[i] = last = last + d;
+    if (events[i].type != TR_ACK) {
+      if (last < lo)
+	lo = last;
+      if (last > hi)
+	hi = last;
+    }
+    if (events[i].type < TR_NUM_TYPES) {
+      count[events[i].type]++;
+      kernel[events[i].type] += events[i].kernel;
+    }
+  }
+
+  numFrames = hi - lo + 1;
+  frames = calloc(numFrames,sizeof(*frames));
+  if (!frames) {
+    printf("out of memory\n");
+    exit (1);
+  }
+
+  // follow each frame through its events.  An ack covers every frame up
+  // to its sequence number that has been sent.
+  acked = lo - 1;
+  for (i=0;i<numEvents;i++) {
+    long long t = events[i].time;
+
+    if (events[i].type == TR_ACK) {
+      for (;acked < seqs[i] && acked < hi;acked++) {
+	f = &frames[acked + 1 - lo];
+	if (f->sent && !f->acked)
+	  f->acked = t;
+      }
+      continue;
+    }
+
+    f = &frames[seqs[i] - lo];
+    switch (events[i].type) {
+    case TR_ENQUEUE:
+      f->enqueued = t;
+      break;
+    case TR_TRANSMIT:
+      if (!f->sent)
+	f->sent = t;
+      f->lastSent = f->unstamped = t;
+      break;
+    case TR_RETRANSMIT:
+      f->resent++;
+      f->lastSent = f->unstamped = t;
+      break;
+    case TR_TX_KERNEL:
+      // a transmission dropped on the way out is never stamped
+      if (f->unstamped)
+	stage (ST_SEND,f->unstamped,t);
+      f->lastSent = t;
+      f->unstamped = 0;
+      break;
+    case TR_ARRIVE:
+      if (!f->arrived) {
+	f->arrived = t;
+	if (f->lastSent)
+	  stage (ST_NETWORK,f->lastSent,t);
+      }
+      break;
+    case TR_DELIVER:
+      if (!f->delivered)
+	f->delivered = t;
+      break;
+    }
+  }
+
+  // and gather the rest of the stages
+  numResent = 0;
+  for (i=0;i<numFrames;i++) {
+    f = &frames[i];
+    if (f->enqueued && f->sent)
+      stage (ST_WINDOW,f->enqueued,f->sent);
+    if (f->arrived && f->delivered)
+      stage (ST_RECEIVE,f->arrived,f->delivered);
+    if (f->sent && f->acked && !f->resent)
+      stage (ST_ACK,f->sent,f->acked);
+    if (f->resent) {
+      numResent++;
+      if (f->sent && f->arrived)
+	stage (ST_RECOVERY,f->sent,f->arrived);
+    }
+    if (f->enqueued && f->delivered)
+      stage (ST_TOTAL,f->enqueued,f->delivered);
+  }
+
+  printf ("%d events, frames %lld to %lld, %d resent.\n",
+	  numEvents,lo,hi,numResent);
+  for (i=0;i<TR_NUM_TYPES;i++)
+    if (count[i])
+      printf ("  %-10s %8d events, %8d stamped by the kernel\n",
+	      typeNames[i],count[i],kernel[i]);
+  printf ("\n%-10s %8s %10s %10s %10s %10s   (usecs)\n",
+	  "stage","frames","p50","p90","p99","max");
+  for (i=0;i<ST_NUM;i++)
+    report (i);
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// stage
+//
+///////////////////////////////////////////////////////////////////////////////
+static void stage (int which, long long from, long long to)
+{
+  // note that a frame spent from to to in a stage
+  if ((numSamples[which] & (numSamples[which] - 1)) == 0) {
+    samples[which] = realloc(samples[which],
+			     2 * (numSamples[which] + 1) * sizeof(long long));
+    if (!samples[which]) {
+      printf("out of memory\n");
+      exit (1);
+    }
+  }
+  samples[which][numSamples[which]++] = to - from;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// report
+//
+///////////////////////////////////////////////////////////////////////////////
+static void report (int which)
+{
+  // print the spread of the times spent in a stage
+  long long *s = samples[which];
+  int n = numSamples[which];
+
+  if (n == 0) {
+    printf ("%-10s %8d\n",stageNames[which],0);
+    return;
+  }
+  qsort (s,n,sizeof(*s),byValue);
+  printf ("%-10s %8d %10.1f %10.1f %10.1f %10.1f\n",stageNames[which],n,
+	  s[(n - 1) * 50 / 100] / 1000.0,s[(n - 1) * 90 / 100] / 1000.0,
+	  s[(n - 1) * 99 / 100] / 1000.0,s[n - 1] / 1000.0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// byTime
+//
+///////////////////////////////////////////////////////////////////////////////
+static int byTime (const void *a, const void *b)
+{
+  const struct TR_event *x = a, *y = b;
+
+  if (x->time != y->time)
+    return x->time < y->time ? -1 : 1;
+  return x->type - y->type;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// byValue
+//
+///////////////////////////////////////////////////////////////////////////////
+static int byValue (const void *a, const void *b)
+{
+  const long long *x = a, *y = b;
+
+  return *x < *y ? -1 : *x > *y;
+}
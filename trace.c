@@ -0,0 +1,269 @@
+//
+// File: trace.c
+//
+// Author: Hamza Sultan Khan Niazi
+//
+// Description: Implementation of the event tracing defined in trace.h.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>     // memcmp
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>       // clock_gettime
+#include "trace.h"
+
+#define TR_MAGIC "SWPTRC1"
+#define TR_HEADER_SIZE 16
+#define TR_RECORD_SIZE 16
+
+// a thread's ring.  Only its thread writes events, at head modulo the
+// size; head counts every event ever recorded, so once it passes the size
+// the oldest events have been overwritten.
+struct TR_ring {
+  atomic_ullong head;
+  unsigned char *records;
+};
+
+// define state variables
+
+static char *TR_fileName = 0;
+static int TR_size;                       // events in each ring
+static struct TR_ring TR_rings [TR_MAX_RINGS];
+static atomic_int TR_numRings;            // rings handed out so far
+static __thread int TR_myRing = -1;       // the calling thread's ring
+
+// prototypes for local functions
+static void TR_putLong (unsigned char *p, unsigned long long v, int bytes);
+static unsigned long long TR_getLong (const unsigned char *p, int bytes);
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// TR_open
+//
+///////////////////////////////////////////////////////////////////////////////
+int TR_open (const char *fileName, int eventsPerThread)
+{
+  int i;
+
+  if (eventsPerThread < 1 || (eventsPerThread & (eventsPerThread - 1)))
+    {
+      printf ("TR_open: events per thread must be a power of two\n");
+      return -1;
+    }
+
+  // the rings are set aside now, since a thread may record its first event
+  // from a signal handler, where we can't call malloc.  Pages of a ring are
+  // only touched once its thread gets that far.
+  for (i=0;i<TR_MAX_RINGS;i++)
+    {
+      TR_rings[i].records = calloc (eventsPerThread,TR_RECORD_SIZE);
+      if (!TR_rings[i].records)
+	{
+	  printf ("TR_open: out of memory\n");
+	  return -1;
+	}
+      atomic_init (&TR_rings[i].head,0);
+    }
+  atomic_init (&TR_numRings,0);
+
+  TR_fileName = strdup (fileName);
+  TR_size = eventsPerThread;
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// TR_record
+//
+///////////////////////////////////////////////////////////////////////////////
+void TR_record (int type, int seq, int stripe, int length, long long time,
+		int kernel)
+{
+  struct TR_ring *ring;
+  unsigned long long head;
+  unsigned char *rec;
+
+  if (!TR_fileName)
+    return;
+
+  // the thread's first event claims it a ring
+  if (TR_myRing < 0)
+    TR_myRing = atomic_fetch_add (&TR_numRings,1);
+  if (TR_myRing >= TR_MAX_RINGS)
+    return;
+  ring = &TR_rings[TR_myRing];
+
+  if (time == 0)
+    time = TR_now ();
+
+  // fill the record, then publish it
+  head = atomic_load_explicit (&ring->head,memory_order_relaxed);
+  rec = ring->records + (head & (TR_size - 1)) * TR_RECORD_SIZE;
+  TR_putLong (rec,time,8);
+  TR_putLong (rec+8,seq,2);
+  rec[10] = type;
+  rec[11] = kernel ? TR_FLAG_KERNEL : 0;
+  rec[12] = stripe;
+  rec[13] = 0;
+  TR_putLong (rec+14,length,2);
+  atomic_store_explicit (&ring->head,head + 1,memory_order_release);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// TR_now
+//
+///////////////////////////////////////////////////////////////////////////////
+long long TR_now (void)
+{
+  // SO_TIMESTAMPING software timestamps are taken on the real time clock
+  struct timespec now;
+
+  clock_gettime (CLOCK_REALTIME,&now);
+  return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// TR_dump
+//
+///////////////////////////////////////////////////////////////////////////////
+int TR_dump (void)
+{
+  unsigned char header [TR_HEADER_SIZE];
+  unsigned long long head[TR_MAX_RINGS],first,count,size;
+  struct TR_ring *ring;
+  FILE *fp;
+  int i,n,ok;
+
+  if (!TR_fileName)
+    return 0;
+  if (!(fp = fopen (TR_fileName,"wb")))
+    {
+      perror ("TR_dump: fopen");
+      return -1;
+    }
+
+  // each ring holds its last TR_size events at most.  Counts are unsigned
+  // like the heads they are compared with.
+  size = TR_size;
+  n = atomic_load (&TR_numRings);
+  if (n > TR_MAX_RINGS)
+    n = TR_MAX_RINGS;
+  count = 0;
+  for (i=0;i<n;i++)
+    {
+      head[i] = atomic_load_explicit (&TR_rings[i].head,memory_order_acquire);
+      count += head[i] < size ? head[i] : size;
+    }
+  memcpy (header,TR_MAGIC,8);
+  TR_putLong (header+8,count,8);
+  ok = fwrite (header,TR_HEADER_SIZE,1,fp) == 1;
+
+  // write each ring oldest first, in at most two pieces
+  for (i=0;i<n && ok;i++)
+    {
+      ring = &TR_rings[i];
+      first = head[i] < size ? 0 : head[i] & (size - 1);
+      count = head[i] < size ? head[i] : size;
+      if (first + count > size)
+	{
+	  ok = fwrite (ring->records + first * TR_RECORD_SIZE,TR_RECORD_SIZE,
+		       size - first,fp) == size - first;
+	  count -= size - first;
+	  first = 0;
+	}
+      if (ok && count > 0)
+	ok = fwrite (ring->records + first * TR_RECORD_SIZE,TR_RECORD_SIZE,
+		     count,fp) == count;
+    }
+
+  if (fclose (fp) != 0 || !ok)
+    {
+      perror ("TR_dump: write");
+      return -1;
+    }
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// TR_load
+//
+///////////////////////////////////////////////////////////////////////////////
+int TR_load (const char *fileName, struct TR_event **events)
+{
+  unsigned char header [TR_HEADER_SIZE], rec [TR_RECORD_SIZE];
+  struct TR_event *ev;
+  unsigned long long count,i;
+  FILE *fp;
+
+  if (!(fp = fopen (fileName,"rb")))
+    {
+      perror ("TR_load: fopen");
+      return -1;
+    }
+  if (fread (header,TR_HEADER_SIZE,1,fp) != 1 ||
+      memcmp (header,TR_MAGIC,8) != 0)
+    {
+      printf ("TR_load: %s is not a trace file\n",fileName);
+      fclose (fp);
+      return -1;
+    }
+
+  count = TR_getLong (header+8,8);
+  *events = ev = malloc ((count ? count : 1) * sizeof(*ev));
+  if (!ev)
+    {
+      printf ("TR_load: out of memory\n");
+      fclose (fp);
+      return -1;
+    }
+  for (i=0;i<count;i++)
+    {
+      if (fread (rec,TR_RECORD_SIZE,1,fp) != 1)
+	{
+	  printf ("TR_load: %s is cut short\n",fileName);
+	  break;
+	}
+      ev[i].time = TR_getLong (rec,8);
+      ev[i].seq = TR_getLong (rec+8,2);
+      ev[i].type = rec[10];
+      ev[i].kernel = (rec[11] & TR_FLAG_KERNEL) != 0;
+      ev[i].stripe = rec[12];
+      ev[i].length = TR_getLong (rec+14,2);
+    }
+
+  fclose (fp);
+  return i;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// TR_putLong
+//
+///////////////////////////////////////////////////////////////////////////////
+static void TR_putLong (unsigned char *p, unsigned long long v, int bytes)
+{
+  // store the low bytes of v, most significant first
+  while (bytes-- > 0)
+    {
+      p[bytes] = v & 0xff;
+      v >>= 8;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// TR_getLong
+//
+///////////////////////////////////////////////////////////////////////////////
+static unsigned long long TR_getLong (const unsigned char *p, int bytes)
+{
+  unsigned long long v = 0;
+
+  while (bytes-- > 0)
+    v = (v << 8) | *p++;
+  return v;
+}
@@ -0,0 +1,82 @@
+//
+// File: trace.h
+//
+// Author: Hamza Sultan Khan Niazi
+//
+// Description: Per-frame event tracing.  Each thread that records events
+// gets a ring of its own, so recording takes no lock; when a ring fills,
+// its oldest events are overwritten.  The rings are written to a binary
+// trace file by TR_dump, and read back by TR_load.
+//
+// A trace file starts with a 16 byte header, the magic "SWPTRC1" and a NUL
+// followed by the number of events as 8 bytes, and then holds one 16 byte
+// record per event, with all fields most significant byte first:
+//    bytes 0-7   time, in nanoseconds since the epoch
+//    bytes 8-9   sequence number of the frame
+//    byte 10     kind of event
+//    byte 11     flags; TR_FLAG_KERNEL marks a time taken by the kernel
+//    byte 12     stripe
+//    byte 13     unused
+//    bytes 14-15 payload length
+//
+// The following functions are defined:
+//    TR_open (const char *fileName, int eventsPerThread)
+//    TR_record (int type, int seq, int stripe, int length, long long time,
+//               int kernel)
+//    TR_now (void)
+//    TR_dump (void)
+//    TR_load (const char *fileName, struct TR_event **events)
+//
+#ifndef _TRACE_H
+#define _TRACE_H
+
+// kinds of event
+#define TR_ENQUEUE    0   // frame's message handed to SWP_send
+#define TR_TRANSMIT   1   // frame first sent
+#define TR_RETRANSMIT 2   // frame resent after a timeout
+#define TR_TX_KERNEL  3   // frame left the socket, as timed by the kernel
+#define TR_ACK        4   // ack came in for every frame up to seq
+#define TR_ARRIVE     5   // frame came in at the receiver
+#define TR_DELIVER    6   // frame handed to the application by SWP_recv
+#define TR_NUM_TYPES  7
+
+#define TR_FLAG_KERNEL 0x01
+
+// most threads that get a ring of their own; events recorded by any more
+// threads are dropped
+#define TR_MAX_RINGS 32
+
+// an event, decoded
+struct TR_event {
+  long long time;
+  int seq;
+  int type;
+  int kernel;
+  int stripe;
+  int length;
+};
+
+int TR_open (const char *fileName, int eventsPerThread);
+// turns tracing on.  Each thread's ring holds eventsPerThread events, a
+// power of two, and TR_dump writes them to fileName.  A negative return
+// value indicates an error.
+
+void TR_record (int type, int seq, int stripe, int length, long long time,
+		int kernel);
+// records an event in the calling thread's ring.  time is in nanoseconds
+// since the epoch, or 0 for now; kernel is true if the kernel took it.  A
+// thread must not record events from a signal handler that may interrupt
+// it while it records an event itself.
+
+long long TR_now (void);
+// returns the time now, in nanoseconds since the epoch, on the clock the
+// kernel uses for its timestamps.
+
+int TR_dump (void);
+// writes every thread's ring to the trace file.  A negative return value
+// indicates an error.
+
+int TR_load (const char *fileName, struct TR_event **events);
+// reads a trace file into a malloc'd array of events, in the order they
+// were written, and returns the number of events, or -1 on an error.
+#endif
@@ -6,28 +6,110 @@
 // Description: Implementation of functions that implement an unreliable
 // UDP connection.
 //
-#include <stdlib.h> // rand
+// Every socket gets its own xoshiro256** generator, seeded from a single
+// session seed, so that runs with the same seed see the same errors and
+// threads sending on different sockets never share generator state.
+// Sockets are numbered in the order they're first used, not by descriptor,
+// so that a build that opens other files sees the same errors.  Errors
+// are either independent (US_FailureProb) or follow a two-state
+// Gilbert-Elliott model.  The error decided for each packet can be written
+// to a trace file and replayed later.  A trace line is tagged with the
+// number of the socket the packet was sent on, and each socket replays its own lines in
+// order, so a replay doesn't depend on how threads sending on different
+// sockets happen to interleave.
+//
+#include <stdlib.h>
+#include <stdio.h>  // trace files
+#include <stdint.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include "unreliableSend.h"
-#include <time.h> 
+#include <time.h>
+#include <unistd.h> // getpid
 #include <string.h> // memmove
+#include <pthread.h>
+#include <stdatomic.h>
+
+// largest datagram we're prepared to garble; anything bigger is passed on
+// untouched
+#define US_MAX_DATAGRAM 65536
+
+// number of sockets that get their own generator.  Sockets with larger
+// descriptors share the last entry, and take turns with it under
+// US_SharedMutex.
+#define US_MAX_SOCKETS 1024
 
 // define state variables
 
 static int US_FailureProb = 0;  //prob of failure, initially 0
 
-// define probabilities of various errors.  This could be more general (i.e.,
-// allow the user to set these), but these should suffice for now. The
-// probabilities should add up to 100.
-#define US_DROP_PROB            20
-#define US_BURST_ERROR_PROB     20
-#define US_ONE_BIT_ERROR_PROB   20
-#define US_TWO_BIT_ERROR_PROB   20
-#define US_THREE_BIT_ERROR_PROB 20
+// probabilities of various errors, given that an error occurs.  The
+// probabilities add up to 100 and can be changed with US_SetErrorMix.
+enum {US_DROP, US_BURST_ERROR, US_ONE_BIT_ERROR, US_TWO_BIT_ERROR,
+      US_THREE_BIT_ERROR, US_NUM_ERRORS};
+static int US_ErrorMix [US_NUM_ERRORS] = {20, 20, 20, 20, 20};
+
+// Gilbert-Elliott burst model.  When enabled, each socket is either in the
+// good state, where packets fail with US_FailureProb, or in the bad state,
+// where they fail with US_BadFailureProb.  The state changes before every
+// packet with the given transition probabilities.
+static int US_BurstModel = 0;
+static int US_GoodToBadProb, US_BadToGoodProb, US_BadFailureProb;
+
+// seed shared by all generators; bumping US_SeedGen makes every socket
+// reseed on its next packet
+static uint64_t US_Seed;
+static int US_SeedSet = 0;
+static int US_SeedGen = 1;
+
+// per socket state
+struct US_state {
+  int seedGen;       // seed generation this generator was seeded from
+  uint64_t rng[4];   // xoshiro256** state
+  int bad;           // true iff in Gilbert-Elliott bad state
+};
+static struct US_state US_SockState [US_MAX_SOCKETS+1];
+
+// the number of each socket descriptor, plus one, or 0 until it's first
+// used.  Numbers are handed out under US_SharedMutex.
+static atomic_int US_SockNumber [US_MAX_SOCKETS];
+static int US_NumSockets = 0;
+static pthread_mutex_t US_SharedMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// the fate of one packet
+enum {US_PASS, US_DROPPED, US_BURST, US_BITS};
+struct US_event {
+  int kind;
+  int burstStart, burstEnd;     // bytes [burstStart,burstEnd) set to 0xff
+  int numBits;                  // bits flipped
+  int byte[3], bit[3];
+};
+
+// the events replayed for one socket, read from the trace up front.  The
+// entry after the last socket's holds lines with no socket, from traces
+// recorded before lines were tagged, which go to packets in the order
+// they're sent on whatever socket.
+struct US_replay {
+  struct US_event *events;
+  int count, size;
+  int next;                     // the next to be replayed
+};
+
+// trace files
+static FILE *US_RecordFile = 0;
+static int US_Replaying = 0;
+static struct US_replay US_Replay [US_MAX_SOCKETS+2];
 
 // prototypes for local functions
-static int US_garble (char *msg, int len);
+static int US_fate (int s, int len, struct US_event *ev);
+static void US_garble (struct US_event *ev, char *msg, int len);
+static void US_decide (struct US_state *st, int len, struct US_event *ev);
+static int US_readEvent (const char *line, int *s, struct US_event *ev);
+static void US_writeEvent (int s, struct US_event *ev);
+static int US_index (int s);
+static struct US_state *US_getState (int s);
+static uint64_t US_next (struct US_state *st);
+static int US_below (struct US_state *st, int n);
 
 ///////////////////////////////////////////////////////////////////////////////
 //
@@ -36,11 +118,142 @@ static int US_garble (char *msg, int len);
 ///////////////////////////////////////////////////////////////////////////////
 void US_SetFailureProb (int newProb)
 {
-  // set failure to newProb
+  // set failure to newProb.  Generators are seeded lazily, from the seed
+  // given to US_SetSeed or, failing that, from the clock.
   US_FailureProb = newProb;
+}
 
-  // start a new random seed
-  srand (time(0));
+///////////////////////////////////////////////////////////////////////////////
+//
+// US_SetSeed
+//
+///////////////////////////////////////////////////////////////////////////////
+void US_SetSeed (unsigned long long seed)
+{
+  US_Seed = seed;
+  US_SeedSet = 1;
+  US_SeedGen++;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// US_SetErrorMix
+//
+///////////////////////////////////////////////////////////////////////////////
+int US_SetErrorMix (int dropProb, int burstProb, int oneBitProb,
+		    int twoBitProb, int threeBitProb)
+{
+  if (dropProb<0 || burstProb<0 || oneBitProb<0 || twoBitProb<0 ||
+      threeBitProb<0 ||
+      dropProb+burstProb+oneBitProb+twoBitProb+threeBitProb != 100)
+    return -1;
+
+  US_ErrorMix[US_DROP] = dropProb;
+  US_ErrorMix[US_BURST_ERROR] = burstProb;
+  US_ErrorMix[US_ONE_BIT_ERROR] = oneBitProb;
+  US_ErrorMix[US_TWO_BIT_ERROR] = twoBitProb;
+  US_ErrorMix[US_THREE_BIT_ERROR] = threeBitProb;
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// US_SetBurstModel
+//
+///////////////////////////////////////////////////////////////////////////////
+void US_SetBurstModel (int goodToBadProb, int badToGoodProb,
+		       int badFailureProb)
+{
+  int i;
+
+  US_BurstModel = (goodToBadProb > 0);
+  US_GoodToBadProb = goodToBadProb;
+  US_BadToGoodProb = badToGoodProb;
+  US_BadFailureProb = badFailureProb;
+
+  // every socket starts out in the good state
+  for (i=0;i<=US_MAX_SOCKETS;i++)
+    US_SockState[i].bad = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// US_RecordTrace
+//
+///////////////////////////////////////////////////////////////////////////////
+int US_RecordTrace (const char *fileName)
+{
+  if (US_RecordFile)
+    fclose (US_RecordFile);
+  US_RecordFile = 0;
+  if (!fileName)
+    return 0;
+
+  if (!(US_RecordFile = fopen (fileName,"w"))) {
+    perror ("US_RecordTrace: fopen");
+    return -1;
+  }
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// US_ReplayTrace
+//
+///////////////////////////////////////////////////////////////////////////////
+int US_ReplayTrace (const char *fileName)
+{
+  struct US_replay *replay;
+  struct US_event ev, *events;
+  char line[128];
+  FILE *file;
+  int s,lineNum,i;
+
+  US_Replaying = 0;
+  for (i=0;i<=US_MAX_SOCKETS+1;i++)
+    {
+      free (US_Replay[i].events);
+      US_Replay[i].events = 0;
+      US_Replay[i].count = US_Replay[i].size = US_Replay[i].next = 0;
+    }
+  if (!fileName)
+    return 0;
+
+  if (!(file = fopen (fileName,"r"))) {
+    perror ("US_ReplayTrace: fopen");
+    return -1;
+  }
+
+  // sort the events out by socket, refusing the whole trace if any line
+  // of it is bad
+  for (lineNum=1;fgets (line,sizeof(line),file);lineNum++)
+    {
+      if (US_readEvent (line,&s,&ev) < 0)
+	{
+	  printf ("US_ReplayTrace: %s line %d is malformed\n",fileName,lineNum);
+	  fclose (file);
+	  US_ReplayTrace (0);
+	  return -1;
+	}
+      replay = &US_Replay[s];
+      if (replay->count == replay->size)
+	{
+	  replay->size = replay->size ? 2 * replay->size : 256;
+	  if (!(events = realloc (replay->events,
+				  replay->size * sizeof(*events))))
+	    {
+	      printf ("US_ReplayTrace: out of memory\n");
+	      fclose (file);
+	      US_ReplayTrace (0);
+	      return -1;
+	    }
+	  replay->events = events;
+	}
+      replay->events[replay->count++] = ev;
+    }
+  fclose (file);
+  US_Replaying = 1;
+  return 0;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -50,17 +263,21 @@ void US_SetFailureProb (int newProb)
 ///////////////////////////////////////////////////////////////////////////////
 int US_send(int s, const char *msg, int len, int flags)
 {
-  char garbledMsg[2048];
+  char garbledMsg[US_MAX_DATAGRAM];
+  struct US_event ev;
 
-  if (rand()%100 >= US_FailureProb)
+  if (len > US_MAX_DATAGRAM || US_fate(s,len,&ev) == US_PASS)
     // we're not causing an error in this packet so send it off normally
     return send (s,msg,len,flags);
 
   // copy the message to a temporary buffer, then garble it  and send it,
   // unless it was completely dropped
-  memmove (&garbledMsg,msg,len);
-  if (US_garble(garbledMsg,len))
-    send (s,garbledMsg,len,flags);
+  if (ev.kind != US_DROPPED)
+    {
+      memmove (&garbledMsg,msg,len);
+      US_garble (&ev,garbledMsg,len);
+      send (s,garbledMsg,len,flags);
+    }
 
   // return as if everything was sent off
   return len;
@@ -74,17 +291,21 @@ int US_send(int s, const char *msg, int len, int flags)
 int US_sendto(int s, const char *msg, int len, int flags,
 	       struct sockaddr *to, int tolen)
 {
-  char garbledMsg[2048];
+  char garbledMsg[US_MAX_DATAGRAM];
+  struct US_event ev;
 
-  if (rand()%100 >= US_FailureProb)
+  if (len > US_MAX_DATAGRAM || US_fate(s,len,&ev) == US_PASS)
     // we're not causing an error in this packet so send it off normally
     return sendto(s,msg,len,flags,to,tolen);
 
   // copy the message to a temporary buffer, then garble it  and send it,
   // unless it was completely dropped
-  memmove (&garbledMsg,msg,len);
-  if (US_garble(garbledMsg,len))
-    sendto (s,garbledMsg,len,flags,to,tolen);
+  if (ev.kind != US_DROPPED)
+    {
+      memmove (&garbledMsg,msg,len);
+      US_garble (&ev,garbledMsg,len);
+      sendto (s,garbledMsg,len,flags,to,tolen);
+    }
 
   // return as if everything was sent off
   return len;
@@ -92,68 +313,399 @@ int US_sendto(int s, const char *msg, int len, int flags,
 
 ///////////////////////////////////////////////////////////////////////////////
 //
-// US_garble
+// US_sendmsg
+//
+///////////////////////////////////////////////////////////////////////////////
+int US_sendmsg(int s, const struct msghdr *msg, int flags)
+{
+  char garbledMsg[US_MAX_DATAGRAM];
+  struct US_event ev;
+  size_t i;
+  int len;
+
+  len = 0;
+  for (i=0;i<msg->msg_iovlen;i++)
+    len += msg->msg_iov[i].iov_len;
+
+  if (len > US_MAX_DATAGRAM || US_fate(s,len,&ev) == US_PASS)
+    // we're not causing an error in this packet so send it off normally,
+    // straight from the caller's buffers
+    return sendmsg(s,msg,flags);
+
+  // gather the pieces into a temporary buffer, then garble it and send it,
+  // unless it was completely dropped
+  if (ev.kind != US_DROPPED)
+    {
+      len = 0;
+      for (i=0;i<msg->msg_iovlen;i++)
+	{
+	  memmove (garbledMsg+len,msg->msg_iov[i].iov_base,
+		   msg->msg_iov[i].iov_len);
+	  len += msg->msg_iov[i].iov_len;
+	}
+      US_garble (&ev,garbledMsg,len);
+      sendto (s,garbledMsg,len,flags,msg->msg_name,msg->msg_namelen);
+    }
+
+  // return as if everything was sent off
+  return len;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// US_Garble
+//
+///////////////////////////////////////////////////////////////////////////////
+int US_Garble (int s, char *msg, int len)
+{
+  struct US_event ev;
+
+  if (len > US_MAX_DATAGRAM || US_fate(s,len,&ev) == US_PASS)
+    return 1;
+  if (ev.kind == US_DROPPED)
+    return 0;
+  US_garble (&ev,msg,len);
+  return 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// US_fate
 //
 ///////////////////////////////////////////////////////////////////////////////
-static int US_garble (char *msg, int len)
+static int US_fate (int s, int len, struct US_event *ev)
 {
-  // garble the message.  Probabilities of various errors are defined
-  // by global constants.
+  // decide the fate of a len byte packet sent on socket s, either from the
+  // trace being replayed or from the socket's generator, and record it.
+  // Entries shared between sockets are only used under US_SharedMutex,
+  // which a replay takes for every packet, since any socket may come to
+  // the untagged lines.  Returns the kind of event.
+  struct US_replay *replay;
+  int shared;
+
+  s = US_index (s);
+  shared = (s == US_MAX_SOCKETS || US_Replaying);
+  if (shared)
+    pthread_mutex_lock (&US_SharedMutex);
+
+  if (len <= 0)
+    ev->kind = US_PASS;
+  else if (!US_Replaying)
+    US_decide (US_getState(s),len,ev);
+  else
+    {
+      // the socket's own events first, then any untagged ones.  Once the
+      // trace is used up, packets pass unharmed.
+      replay = &US_Replay[s];
+      if (replay->next == replay->count)
+	replay = &US_Replay[US_MAX_SOCKETS+1];
+      if (replay->next < replay->count)
+	*ev = replay->events[replay->next++];
+      else
+	ev->kind = US_PASS;
+    }
+
+  if (US_RecordFile)
+    US_writeEvent (s,ev);
+
+  if (shared)
+    pthread_mutex_unlock (&US_SharedMutex);
+  return ev->kind;
+}
 
-  int randNum = rand()%100;
-  int burstStart,burstEnd;
-  int randByte,randBit;
-  int numBits;
+///////////////////////////////////////////////////////////////////////////////
+//
+// US_garble
+//
+///////////////////////////////////////////////////////////////////////////////
+static void US_garble (struct US_event *ev, char *msg, int len)
+{
+  // apply error ev to msg
   int i;
 
-  // dropped packet
-  if (randNum < US_DROP_PROB)
+  switch (ev->kind)
     {
-      // simulate a dropped packet.  Return indication that nothing should
-      // be sent out.
+    case US_BURST:
+      // a trace may have been recorded with a different frame size, so
+      // make the burst fit this packet
+      if (ev->burstStart >= len)
+	ev->burstStart %= len;
+      if (ev->burstEnd > len)
+	ev->burstEnd = len;
+      for (i=ev->burstStart;i<ev->burstEnd;i++)
+	msg[i] = 0xff;
 #ifdef DEBUG
-      printf ("dropped packet\n");
+      printf ("burst error\n");
 #endif
-      return 0;
+      break;
+
+    case US_BITS:
+      for (i=0;i<ev->numBits;i++)
+	msg[ev->byte[i]%len] ^= (0x01 << ev->bit[i]);
+#ifdef DEBUG
+      printf ("%d bit error\n",ev->numBits);
+#endif
+      break;
     }
-  randNum -= US_DROP_PROB;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// US_decide
+//
+///////////////////////////////////////////////////////////////////////////////
+static void US_decide (struct US_state *st, int len, struct US_event *ev)
+{
+  // decide what happens to a packet of len bytes.  Probabilities of
+  // various errors are given by US_ErrorMix.
+  int failureProb = US_FailureProb;
+  int randNum;
+  int i;
+
+  // move the Gilbert-Elliott chain on one step
+  if (US_BurstModel)
+    {
+      if (st->bad)
+	st->bad = !(US_below(st,100) < US_BadToGoodProb);
+      else
+	st->bad = (US_below(st,100) < US_GoodToBadProb);
+      if (st->bad)
+	failureProb = US_BadFailureProb;
+    }
+
+  ev->kind = US_PASS;
+  if (US_below(st,100) >= failureProb)
+    return;
+
+  randNum = US_below(st,100);
+
+  // dropped packet
+  if (randNum < US_ErrorMix[US_DROP])
+    {
+      ev->kind = US_DROPPED;
+      return;
+    }
+  randNum -= US_ErrorMix[US_DROP];
 
   // burst error
-  if (randNum < US_BURST_ERROR_PROB)
+  if (randNum < US_ErrorMix[US_BURST_ERROR])
     {
       // simulate a random length burst error.  All bits in the burst are
       // set to 1
-      burstStart = rand()%len;
-      burstEnd = rand()%(len-burstStart)+burstStart+1;
-      for (i=burstStart;i<=burstEnd;i++)
-	msg[i] = 0xff;
-#ifdef DEBUG
-      printf ("burst error\n");
-#endif
-      return 1;
+      ev->kind = US_BURST;
+      ev->burstStart = US_below(st,len);
+      ev->burstEnd = US_below(st,len-ev->burstStart)+ev->burstStart+1;
+      return;
     }
-  randNum -= US_BURST_ERROR_PROB;
+  randNum -= US_ErrorMix[US_BURST_ERROR];
 
   // it must be a 1, 2, or 3 bit error
-  if (randNum < US_ONE_BIT_ERROR_PROB)
-    numBits = 1;
+  ev->kind = US_BITS;
+  if (randNum < US_ErrorMix[US_ONE_BIT_ERROR])
+    ev->numBits = 1;
   else
     {
-      randNum -= US_ONE_BIT_ERROR_PROB;
-      if (randNum < US_TWO_BIT_ERROR_PROB)
-	numBits = 2;
+      randNum -= US_ErrorMix[US_ONE_BIT_ERROR];
+      if (randNum < US_ErrorMix[US_TWO_BIT_ERROR])
+	ev->numBits = 2;
       else
-	numBits = 3;
+	ev->numBits = 3;
     }
 
-  for (i=0;i<numBits;i++)
+  for (i=0;i<ev->numBits;i++)
     {
-      randByte = rand()%len;
-      randBit = rand()%8;
-      msg[randByte] ^= (0x01 << randBit);
+      ev->byte[i] = US_below(st,len);
+      ev->bit[i] = US_below(st,8);
     }
-#ifdef DEBUG
-  printf ("%d bit error\n",numBits);
-#endif
-  return 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// US_readEvent
+//
+///////////////////////////////////////////////////////////////////////////////
+static int US_readEvent (const char *line, int *s, struct US_event *ev)
+{
+  // parse a line of a replay trace into ev, and set s to the index of the
+  // socket it's for.  The trace has one line per packet, each starting
+  // with the number of the socket it was sent on, or not for an older
+  // trace:
+  //    <sock> -                       packet passed unharmed
+  //    <sock> D                       packet dropped
+  //    <sock> B <start> <end>         bytes [start,end) set to 0xff
+  //    <sock> F <byte> <bit> ...      1 to 3 bits flipped
+  // Returns -1 if the line is malformed, or would garble bytes outside
+  // the packet.
+  int sock,used,n,i;
+
+  *s = US_MAX_SOCKETS + 1;
+  if (sscanf (line,"%d %n",&sock,&used) == 1)
+    {
+      if (sock < 0 || sock > US_MAX_SOCKETS)
+	return -1;
+      *s = sock;
+      line += used;
+    }
+
+  switch (line[0])
+    {
+    case '-':
+      ev->kind = US_PASS;
+      break;
+    case 'D':
+      ev->kind = US_DROPPED;
+      break;
+    case 'B':
+      ev->kind = US_BURST;
+      if (sscanf (line+1,"%d %d",&ev->burstStart,&ev->burstEnd) != 2 ||
+	  ev->burstStart < 0 || ev->burstEnd <= ev->burstStart)
+	return -1;
+      break;
+    case 'F':
+      ev->kind = US_BITS;
+      n = sscanf (line+1,"%d %d %d %d %d %d",&ev->byte[0],&ev->bit[0],
+		  &ev->byte[1],&ev->bit[1],&ev->byte[2],&ev->bit[2]);
+      if (n < 2 || n % 2)
+	return -1;
+      ev->numBits = n/2;
+      for (i=0;i<ev->numBits;i++)
+	if (ev->byte[i] < 0 || ev->bit[i] < 0 || ev->bit[i] > 7)
+	  return -1;
+      break;
+    default:
+      return -1;
+    }
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// US_writeEvent
+//
+///////////////////////////////////////////////////////////////////////////////
+static void US_writeEvent (int s, struct US_event *ev)
+{
+  // append ev, for a packet sent on the socket with index s, to the record
+  // trace, in the format read by US_readEvent.  Each line goes out in one
+  // call, so lines from threads sending on different sockets don't run
+  // together.
+  switch (ev->kind)
+    {
+    case US_DROPPED:
+      fprintf (US_RecordFile,"%d D\n",s);
+      break;
+    case US_BURST:
+      fprintf (US_RecordFile,"%d B %d %d\n",s,ev->burstStart,ev->burstEnd);
+      break;
+    case US_BITS:
+      if (ev->numBits == 1)
+	fprintf (US_RecordFile,"%d F %d %d\n",s,ev->byte[0],ev->bit[0]);
+      else if (ev->numBits == 2)
+	fprintf (US_RecordFile,"%d F %d %d %d %d\n",s,ev->byte[0],ev->bit[0],
+		 ev->byte[1],ev->bit[1]);
+      else
+	fprintf (US_RecordFile,"%d F %d %d %d %d %d %d\n",s,ev->byte[0],
+		 ev->bit[0],ev->byte[1],ev->bit[1],ev->byte[2],ev->bit[2]);
+      break;
+    default:
+      fprintf (US_RecordFile,"%d -\n",s);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// US_index
+//
+///////////////////////////////////////////////////////////////////////////////
+static int US_index (int s)
+{
+  // the entry of socket s in the per socket tables, which is its number in
+  // the order sockets were first used.  Sockets with larger descriptors,
+  // and any past the first US_MAX_SOCKETS, share the last.
+  int number;
+
+  if (s < 0 || s >= US_MAX_SOCKETS)
+    return US_MAX_SOCKETS;
+  if ((number = atomic_load (&US_SockNumber[s])) != 0)
+    return number - 1;
+
+  // first use; number it, unless another thread just has
+  pthread_mutex_lock (&US_SharedMutex);
+  if ((number = atomic_load (&US_SockNumber[s])) == 0)
+    {
+      number = US_NumSockets < US_MAX_SOCKETS ? ++US_NumSockets
+	: US_MAX_SOCKETS + 1;
+      atomic_store (&US_SockNumber[s],number);
+    }
+  pthread_mutex_unlock (&US_SharedMutex);
+  return number - 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// US_getState
+//
+///////////////////////////////////////////////////////////////////////////////
+static struct US_state *US_getState (int s)
+{
+  // return the state of the socket with index s, (re)seeding its
+  // generator if the seed changed since it was last used
+  struct US_state *st;
+  uint64_t x;
+  int i;
+
+  st = &US_SockState[s];
+
+  if (st->seedGen != US_SeedGen)
+    {
+      if (!US_SeedSet)
+	US_SetSeed (((uint64_t)time(0) << 20) ^ getpid());
+
+      // expand seed and socket index into the generator state using
+      // splitmix64
+      x = US_Seed ^ ((uint64_t)s * 0x9e3779b97f4a7c15ULL);
+      for (i=0;i<4;i++)
+	{
+	  uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+	  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	  st->rng[i] = z ^ (z >> 31);
+	}
+      st->bad = 0;
+      st->seedGen = US_SeedGen;
+    }
+  return st;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// US_next
+//
+///////////////////////////////////////////////////////////////////////////////
+static uint64_t US_next (struct US_state *st)
+{
+  // xoshiro256** step
+  uint64_t *s = st->rng;
+  uint64_t result = s[1] * 5;
+  uint64_t t = s[1] << 17;
+
+  result = ((result << 7) | (result >> 57)) * 9;
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = (s[3] << 45) | (s[3] >> 19);
+  return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// US_below
+//
+///////////////////////////////////////////////////////////////////////////////
+static int US_below (struct US_state *st, int n)
+{
+  // uniform random number in [0,n), using a multiply rather than a divide
+  return (int)(((US_next(st) >> 32) * (uint64_t)n) >> 32);
 }
@@ -7,18 +7,66 @@
 // functions are defined:
 //
 //    US_SetFailureProb (int newProb)
+//    US_SetSeed (unsigned long long seed)
+//    US_SetErrorMix (int dropProb, int burstProb, int oneBitProb,
+//                    int twoBitProb, int threeBitProb)
+//    US_SetBurstModel (int goodToBadProb, int badToGoodProb,
+//                      int badFailureProb)
+//    US_RecordTrace (const char *fileName)
+//    US_ReplayTrace (const char *fileName)
 //    US_send (int s,const char *msg,int len,int flags)
 //    US_sendto (int s, const char *msg, int len, int flags,
 //               struct sockaddr *to, int tolen)
+//    US_sendmsg (int s, const struct msghdr *msg, int flags)
+//    US_Garble (int s, char *msg, int len)
 //
-// The behavior of US_send and US_sendto are identical to send and sendto
-// except that packets are randomly dropped.  These simulate unreilable links.
+// The behavior of US_send, US_sendto and US_sendmsg are identical to send,
+// sendto and sendmsg except that packets are randomly dropped.  These simulate unreilable links.
 //
 #ifndef _UNRELIABLE_SEND_H
 #define _UNRELIABLE_SEND_H
 
 void US_SetFailureProb (int newProb);
+// sets the probability (in percent) that a packet is dropped or garbled.
+
+void US_SetSeed (unsigned long long seed);
+// seeds the per-socket random number generators.  Two runs with the same
+// seed and the same traffic see the same errors.  If no seed is given the
+// generators are seeded from the clock.
+
+int US_SetErrorMix (int dropProb, int burstProb, int oneBitProb,
+		    int twoBitProb, int threeBitProb);
+// sets how errors are split between dropped packets, burst errors and 1, 2
+// or 3 bit errors.  The probabilities are in percent and must add up to 100;
+// the default is 20 each.  A negative return value indicates an error.
+
+void US_SetBurstModel (int goodToBadProb, int badToGoodProb,
+		       int badFailureProb);
+// enables the Gilbert-Elliott burst loss model.  Each socket moves between
+// a good state, where packets fail with the probability given to
+// US_SetFailureProb, and a bad state, where they fail with badFailureProb.
+// Before every packet the state changes with probability goodToBadProb or
+// badToGoodProb (all in percent).  A goodToBadProb of 0 disables the model.
+
+int US_RecordTrace (const char *fileName);
+int US_ReplayTrace (const char *fileName);
+// record the fate of every packet sent to fileName, or replay the fates
+// recorded in fileName instead of drawing them at random.  Each socket
+// replays the fates recorded for it, in order, and packets it sends after
+// those run out are not garbled.  Sockets, like their generators, are
+// told apart by the order in which they were first used, so a trace
+// replays the same in a run that opens other descriptors.  A null fileName stops recording or
+// replaying.  A negative return value indicates an error, such as a
+// malformed line in the trace replayed.
+
 int US_send(int s, const char *msg, int len, int flags);
 int US_sendto(int s, const char *msg, int len, int flags,
 	      struct sockaddr *to, int tolen);
+int US_sendmsg(int s, const struct msghdr *msg, int flags);
+
+int US_Garble (int s, char *msg, int len);
+// for a packet that goes some other way than through a socket: decides
+// the fate of the len byte packet at msg as if it were being sent on
+// socket s, and garbles it in place if that is its fate.  Returns 0 if the
+// packet is to be dropped, and 1 if it's to be sent.
 #endif
@@ -0,0 +1,616 @@
+//
+// File: uring.c
+//
+// Author: Hamza Sultan Khan Niazi
+//
+// Description: Implementation of the rings defined in uring.h.  A ring is
+// two io_urings, each a queue of requests and a queue of completions
+// mapped from the kernel: one for the receives, and one for the sends.
+// The thread in UR_wait waits on the first only, so that it isn't woken
+// each time a datagram goes out; the completions of the sends are taken
+// when their slots are wanted again.  Our own count of request entries
+// filled runs ahead of the kernel's tail until the ring is submitted.
+// Every request carries in its user data the socket or the slot it's
+// for.  The buffers to receive into are handed to the kernel through a
+// ring of their own, which it takes them from as datagrams come in; each
+// is laid out as recvmsg leaves it, a header and the sender's address
+// ahead of the datagram.  Closing the sockets doesn't end their
+// receives, so a thread in UR_wait sleeps for at most UR_STOP_NSECS at a
+// time before it looks for a stop.
+//
+#include <sys/types.h>
+#include <sys/mman.h>     // mmap
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>      // struct iovec
+#include <linux/io_uring.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>       // calloc
+#include <string.h>       // memset
+#include <unistd.h>       // syscall, close
+#include "uring.h"
+
+#define UR_GROUP 0              // the group our buffers are provided as
+#define UR_ALIGN(n) (((n) + 63) & ~63)
+#define UR_STOP_NSECS 100000000 // longest a stop may go unseen
+
+// the head of a buffer, ahead of the datagram
+#define UR_PREFIX (sizeof(struct io_uring_recvmsg_out) + \
+		   sizeof(struct sockaddr_in))
+
+// one io_uring, and how far we've filled its request queue
+struct UR_queue {
+  int fd;
+  void *queues;
+  size_t queuesSize;
+  struct io_uring_sqe *sqes;
+  size_t sqesSize;
+  unsigned *sqHead, *sqTail, *sqMask;
+  unsigned sqEntries;
+  unsigned sqFilled;           // entries filled, submitted or not
+  unsigned *cqHead, *cqTail, *cqMask;
+  struct io_uring_cqe *cqes;
+};
+
+struct UR_socket {
+  int sock;
+  int tag;
+  int posted;                  // true iff its receive is queued or running
+  struct msghdr msg;           // says how much room the address gets
+};
+
+struct UR_ring {
+  struct UR_queue in, out;
+
+  // the buffers to receive into
+  struct io_uring_buf_ring *bufRing;
+  unsigned short bufTail;
+  unsigned char *buffers;
+  int bufferSize;
+
+  struct UR_socket socket [UR_MAX_SOCKETS];
+  int numSockets;
+  int unposted;                // true iff a receive couldn't be queued
+
+  // the send pool.  free holds the slots not in use, and to the address
+  // of the datagram in each slot, which must stay put until it's sent.
+  unsigned char *pool;
+  int slotSize, sendSize;
+  int free [UR_SLOTS];
+  int numFree;
+  struct sockaddr_in to [UR_SLOTS];
+  int registered;              // true iff the kernel has the pool registered
+  int zeroCopy;                // true iff big datagrams go without a copy
+  int stopped;                 // true once UR_stop has been called
+};
+
+// prototypes for local functions
+static int UR_setup (struct UR_queue *q, int entries, int completions);
+static int UR_supported (int fd);
+static struct io_uring_sqe *UR_entry (struct UR_queue *q);
+static void UR_push (struct UR_queue *q);
+static void UR_reap (struct UR_ring *ring);
+static void UR_post (struct UR_ring *ring, int index);
+static void UR_provide (struct UR_ring *ring, int buffer);
+static void UR_unmap (struct UR_queue *q);
+static int UR_enter (int fd, unsigned submit, unsigned wait, unsigned flags,
+		     struct io_uring_getevents_arg *arg);
+static int UR_register (int fd, unsigned op, void *arg, unsigned count);
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// UR_open
+//
+///////////////////////////////////////////////////////////////////////////////
+struct UR_ring *UR_open (int recvSize, int sendSize)
+{
+  struct io_uring_buf_reg reg;
+  struct iovec iov;
+  struct UR_ring *ring;
+  int i;
+
+  if (!(ring = calloc (1,sizeof(*ring))))
+    return 0;
+  ring->in.fd = ring->out.fd = -1;
+  ring->bufRing = MAP_FAILED;
+  ring->buffers = ring->pool = MAP_FAILED;
+
+  // a receive is posted once for each socket, and then only again if it
+  // ends, but each datagram in takes a completion.  Each datagram out
+  // takes a request and a completion, or two without a copy, and can't
+  // be sent until a slot is free.  The kernel holds on to completions
+  // that don't fit.
+  if (UR_setup (&ring->in,2 * UR_MAX_SOCKETS,4 * UR_BUFFERS) < 0 ||
+      UR_setup (&ring->out,UR_SLOTS,2 * UR_SLOTS) < 0 ||
+      !UR_supported (ring->out.fd))
+    {
+      UR_close (ring);
+      return 0;
+    }
+
+  // give the kernel the buffers to receive into
+  ring->bufferSize = UR_ALIGN(UR_PREFIX + recvSize);
+  ring->bufRing = mmap (0,UR_BUFFERS * sizeof(struct io_uring_buf),
+			PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+  ring->buffers = mmap (0,(size_t)UR_BUFFERS * ring->bufferSize,
+			PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+  memset (&reg,0,sizeof(reg));
+  reg.ring_addr = (uintptr_t)ring->bufRing;
+  reg.ring_entries = UR_BUFFERS;
+  reg.bgid = UR_GROUP;
+  if (ring->bufRing == MAP_FAILED || ring->buffers == MAP_FAILED ||
+      UR_register (ring->in.fd,IORING_REGISTER_PBUF_RING,&reg,1) < 0)
+    {
+      UR_close (ring);
+      return 0;
+    }
+  for (i=0;i<UR_BUFFERS;i++)
+    UR_provide (ring,i);
+
+  // and the send pool, registered if the kernel will let us pin it
+  ring->sendSize = sendSize;
+  ring->slotSize = UR_ALIGN(sendSize);
+  ring->pool = mmap (0,(size_t)UR_SLOTS * ring->slotSize,
+		     PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+  if (ring->pool == MAP_FAILED)
+    {
+      UR_close (ring);
+      return 0;
+    }
+  iov.iov_base = ring->pool;
+  iov.iov_len = (size_t)UR_SLOTS * ring->slotSize;
+  ring->registered =
+    UR_register (ring->out.fd,IORING_REGISTER_BUFFERS,&iov,1) == 0;
+  ring->zeroCopy = sendSize >= UR_ZERO_COPY_MIN;
+  for (i=0;i<UR_SLOTS;i++)
+    ring->free[i] = UR_SLOTS - 1 - i;
+  ring->numFree = UR_SLOTS;
+
+  return ring;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// UR_recv
+//
+///////////////////////////////////////////////////////////////////////////////
+int UR_recv (struct UR_ring *ring, int sock, int tag)
+{
+  struct UR_socket *s;
+
+  if (ring->numSockets == UR_MAX_SOCKETS)
+    return -1;
+
+  s = &ring->socket[ring->numSockets];
+  s->sock = sock;
+  s->tag = tag;
+  memset (&s->msg,0,sizeof(s->msg));
+  s->msg.msg_namelen = sizeof(struct sockaddr_in);
+  UR_post (ring,ring->numSockets++);
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// UR_reserve
+//
+///////////////////////////////////////////////////////////////////////////////
+unsigned char *UR_reserve (struct UR_ring *ring, int length)
+{
+  if (ring->numFree == 0)
+    UR_reap (ring);
+  if (length < 0 || length > ring->sendSize || ring->numFree == 0)
+    return 0;
+  return ring->pool + (size_t)ring->free[ring->numFree - 1] * ring->slotSize;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// UR_send
+//
+///////////////////////////////////////////////////////////////////////////////
+void UR_send (struct UR_ring *ring, int sock, const struct sockaddr_in *to,
+	      int length)
+{
+  struct io_uring_sqe *sqe;
+  int slot;
+
+  // the datagram is dropped if it can't be queued
+  if (!(sqe = UR_entry (&ring->out)))
+    return;
+  slot = ring->free[--ring->numFree];
+  ring->to[slot] = *to;
+
+  sqe->opcode = IORING_OP_SEND;
+  sqe->fd = sock;
+  sqe->addr = (uintptr_t)(ring->pool + (size_t)slot * ring->slotSize);
+  sqe->len = length;
+  sqe->addr2 = (uintptr_t)&ring->to[slot];
+  sqe->addr_len = sizeof(struct sockaddr_in);
+  sqe->user_data = slot;
+
+  // a big datagram goes straight from its slot
+  if (ring->zeroCopy && length >= UR_ZERO_COPY_MIN)
+    {
+      sqe->opcode = IORING_OP_SEND_ZC;
+      if (ring->registered)
+	{
+	  sqe->ioprio = IORING_RECVSEND_FIXED_BUF;
+	  sqe->buf_index = 0;
+	}
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// UR_submit
+//
+///////////////////////////////////////////////////////////////////////////////
+void UR_submit (struct UR_ring *ring)
+{
+  UR_push (&ring->in);
+  UR_push (&ring->out);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// UR_wait
+//
+///////////////////////////////////////////////////////////////////////////////
+void UR_wait (struct UR_ring *ring)
+{
+  struct io_uring_getevents_arg arg;
+  struct __kernel_timespec timeout;
+
+  memset (&arg,0,sizeof(arg));
+  timeout.tv_sec = 0;
+  timeout.tv_nsec = UR_STOP_NSECS;
+  arg.ts = (uintptr_t)&timeout;
+  if (!__atomic_load_n (&ring->stopped,__ATOMIC_ACQUIRE) &&
+      __atomic_load_n (ring->in.cqHead,__ATOMIC_ACQUIRE) ==
+      __atomic_load_n (ring->in.cqTail,__ATOMIC_ACQUIRE))
+    UR_enter (ring->in.fd,0,1,IORING_ENTER_GETEVENTS|IORING_ENTER_EXT_ARG,
+	      &arg);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// UR_stop
+//
+///////////////////////////////////////////////////////////////////////////////
+void UR_stop (struct UR_ring *ring)
+{
+  __atomic_store_n (&ring->stopped,1,__ATOMIC_RELEASE);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// UR_next
+//
+///////////////////////////////////////////////////////////////////////////////
+int UR_next (struct UR_ring *ring, struct UR_datagram *datagram)
+{
+  struct UR_queue *q = &ring->in;
+  struct io_uring_cqe *cqe;
+  struct io_uring_recvmsg_out *out;
+  unsigned head;
+  unsigned char *p;
+  int i,buffer,found;
+
+  UR_reap (ring);
+
+  // a receive that couldn't be queued again before is tried again now
+  if (ring->unposted)
+    for (ring->unposted=i=0;i<ring->numSockets;i++)
+      if (!ring->socket[i].posted)
+	UR_post (ring,i);
+
+  found = 0;
+  head = *q->cqHead;
+  while (!found && head != __atomic_load_n (q->cqTail,__ATOMIC_ACQUIRE))
+    {
+      cqe = &q->cqes[head++ & *q->cqMask];
+
+      // a receive ends when it runs out of buffers, or on an error
+      i = cqe->user_data;
+      if (!(cqe->flags & IORING_CQE_F_MORE))
+	{
+	  ring->socket[i].posted = 0;
+	  UR_post (ring,i);
+	}
+      if (!(cqe->flags & IORING_CQE_F_BUFFER))
+	continue;
+
+      // a datagram cut short is dropped, as recvmsg would drop the rest
+      buffer = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+      p = ring->buffers + (size_t)buffer * ring->bufferSize;
+      out = (struct io_uring_recvmsg_out *)p;
+      if (cqe->res < (int)UR_PREFIX || (out->flags & MSG_TRUNC) ||
+	  out->namelen != sizeof(struct sockaddr_in))
+	{
+	  UR_provide (ring,buffer);
+	  continue;
+	}
+
+      datagram->tag = ring->socket[i].tag;
+      datagram->data = p + UR_PREFIX;
+      datagram->length = out->payloadlen;
+      memcpy (&datagram->from,p + sizeof(*out),sizeof(datagram->from));
+      datagram->buffer = buffer;
+      found = 1;
+    }
+  __atomic_store_n (q->cqHead,head,__ATOMIC_RELEASE);
+  return found;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// UR_done
+//
+///////////////////////////////////////////////////////////////////////////////
+void UR_done (struct UR_ring *ring, struct UR_datagram *datagram)
+{
+  UR_provide (ring,datagram->buffer);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// UR_close
+//
+///////////////////////////////////////////////////////////////////////////////
+void UR_close (struct UR_ring *ring)
+{
+  // undo as much of UR_open as was done.  The rings go first, so that the
+  // kernel is done with the buffers before they are.
+  UR_unmap (&ring->in);
+  UR_unmap (&ring->out);
+  if (ring->pool != MAP_FAILED)
+    munmap (ring->pool,(size_t)UR_SLOTS * ring->slotSize);
+  if (ring->buffers != MAP_FAILED)
+    munmap (ring->buffers,(size_t)UR_BUFFERS * ring->bufferSize);
+  if (ring->bufRing != MAP_FAILED)
+    munmap (ring->bufRing,UR_BUFFERS * sizeof(struct io_uring_buf));
+  free (ring);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// UR_setup
+//
+///////////////////////////////////////////////////////////////////////////////
+static int UR_setup (struct UR_queue *q, int entries, int completions)
+{
+  // set up an io_uring with room for the given numbers of requests and
+  // completions, and map its queues.  Returns -1 if we can't.
+  struct io_uring_params params;
+  size_t cqSize;
+  char *p;
+  unsigned i;
+
+  q->queues = q->sqes = MAP_FAILED;
+  memset (&params,0,sizeof(params));
+  params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL;
+  params.cq_entries = completions;
+  if ((q->fd = syscall (SYS_io_uring_setup,entries,&params)) < 0 ||
+      !(params.features & IORING_FEAT_SINGLE_MMAP) ||
+      !(params.features & IORING_FEAT_NODROP) ||
+      !(params.features & IORING_FEAT_EXT_ARG))
+    return -1;
+
+  q->queuesSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cqSize = params.cq_off.cqes +
+    params.cq_entries * sizeof(struct io_uring_cqe);
+  if (q->queuesSize < cqSize)
+    q->queuesSize = cqSize;
+  q->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+  q->queues = mmap (0,q->queuesSize,PROT_READ|PROT_WRITE,
+		    MAP_SHARED|MAP_POPULATE,q->fd,IORING_OFF_SQ_RING);
+  q->sqes = mmap (0,q->sqesSize,PROT_READ|PROT_WRITE,
+		  MAP_SHARED|MAP_POPULATE,q->fd,IORING_OFF_SQES);
+  if (q->queues == MAP_FAILED || q->sqes == MAP_FAILED)
+    return -1;
+
+  p = q->queues;
+  q->sqHead = (unsigned *)(p + params.sq_off.head);
+  q->sqTail = (unsigned *)(p + params.sq_off.tail);
+  q->sqMask = (unsigned *)(p + params.sq_off.ring_mask);
+  q->sqEntries = params.sq_entries;
+  q->sqFilled = *q->sqTail;
+  q->cqHead = (unsigned *)(p + params.cq_off.head);
+  q->cqTail = (unsigned *)(p + params.cq_off.tail);
+  q->cqMask = (unsigned *)(p + params.cq_off.ring_mask);
+  q->cqes = (struct io_uring_cqe *)(p + params.cq_off.cqes);
+
+  // entry i of the queue is always request i
+  for (i=0;i<params.sq_entries;i++)
+    ((unsigned *)(p + params.sq_off.array))[i] = i;
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// UR_supported
+//
+///////////////////////////////////////////////////////////////////////////////
+static int UR_supported (int fd)
+{
+  // true iff the kernel behind io_uring fd can do all we ask of it.  The
+  // addressed sends came in with the zero copy sendmsg, in 6.1.
+  static const int needed[] = {IORING_OP_RECVMSG,IORING_OP_SEND,
+			       IORING_OP_SEND_ZC,IORING_OP_SENDMSG_ZC};
+  struct io_uring_probe *probe;
+  size_t i;
+  int ok;
+
+  probe = calloc (1,sizeof(*probe) +
+		  IORING_OP_LAST * sizeof(struct io_uring_probe_op));
+  if (!probe)
+    return 0;
+  ok = UR_register (fd,IORING_REGISTER_PROBE,probe,IORING_OP_LAST) == 0;
+  for (i=0;ok && i<sizeof(needed)/sizeof(needed[0]);i++)
+    ok = needed[i] <= probe->last_op &&
+      (probe->ops[needed[i]].flags & IO_URING_OP_SUPPORTED);
+  free (probe);
+  return ok;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// UR_entry
+//
+///////////////////////////////////////////////////////////////////////////////
+static struct io_uring_sqe *UR_entry (struct UR_queue *q)
+{
+  // the next request entry to fill, cleared, or null if the queue is
+  // still full once what's in it has been submitted
+  struct io_uring_sqe *sqe;
+
+  if (q->sqFilled - __atomic_load_n (q->sqHead,__ATOMIC_ACQUIRE) >=
+      q->sqEntries)
+    {
+      UR_push (q);
+      if (q->sqFilled - __atomic_load_n (q->sqHead,__ATOMIC_ACQUIRE) >=
+	  q->sqEntries)
+	return 0;
+    }
+
+  sqe = &q->sqes[q->sqFilled++ & *q->sqMask];
+  memset (sqe,0,sizeof(*sqe));
+  return sqe;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// UR_push
+//
+///////////////////////////////////////////////////////////////////////////////
+static void UR_push (struct UR_queue *q)
+{
+  // submit the requests filled in since the last time, if there are any
+  unsigned pending;
+  int n;
+
+  __atomic_store_n (q->sqTail,q->sqFilled,__ATOMIC_RELEASE);
+  pending = q->sqFilled - __atomic_load_n (q->sqHead,__ATOMIC_ACQUIRE);
+  while (pending > 0)
+    {
+      // whatever the kernel can't take now goes with the next submission
+      if ((n = UR_enter (q->fd,pending,0,0,0)) < 0 && errno == EINTR)
+	continue;
+      if (n <= 0)
+	break;
+      pending -= n;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// UR_reap
+//
+///////////////////////////////////////////////////////////////////////////////
+static void UR_reap (struct UR_ring *ring)
+{
+  // take the completions of the datagrams sent.  A slot comes back once
+  // the kernel has said all it's going to about its datagram; one sent
+  // without a copy has a second completion, when the kernel is done with
+  // the slot.
+  struct UR_queue *q = &ring->out;
+  struct io_uring_cqe *cqe;
+  unsigned head;
+
+  head = *q->cqHead;
+  while (head != __atomic_load_n (q->cqTail,__ATOMIC_ACQUIRE))
+    {
+      cqe = &q->cqes[head++ & *q->cqMask];
+      if (!(cqe->flags & IORING_CQE_F_MORE))
+	ring->free[ring->numFree++] = cqe->user_data;
+    }
+  __atomic_store_n (q->cqHead,head,__ATOMIC_RELEASE);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// UR_post
+//
+///////////////////////////////////////////////////////////////////////////////
+static void UR_post (struct UR_ring *ring, int index)
+{
+  // queue the multishot receive on socket index, into our buffers.  If it
+  // can't be queued, UR_next tries again.
+  struct UR_socket *s = &ring->socket[index];
+  struct io_uring_sqe *sqe;
+
+  if (!(sqe = UR_entry (&ring->in)))
+    {
+      ring->unposted = 1;
+      return;
+    }
+  sqe->opcode = IORING_OP_RECVMSG;
+  sqe->fd = s->sock;
+  sqe->addr = (uintptr_t)&s->msg;
+  sqe->len = 1;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = UR_GROUP;
+  sqe->user_data = index;
+  s->posted = 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// UR_provide
+//
+///////////////////////////////////////////////////////////////////////////////
+static void UR_provide (struct UR_ring *ring, int buffer)
+{
+  // hand buffer to the kernel to receive into
+  struct io_uring_buf *buf;
+
+  buf = &ring->bufRing->bufs[ring->bufTail & (UR_BUFFERS - 1)];
+  buf->addr = (uintptr_t)(ring->buffers + (size_t)buffer * ring->bufferSize);
+  buf->len = ring->bufferSize;
+  buf->bid = buffer;
+  __atomic_store_n (&ring->bufRing->tail,++ring->bufTail,__ATOMIC_RELEASE);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// UR_unmap
+//
+///////////////////////////////////////////////////////////////////////////////
+static void UR_unmap (struct UR_queue *q)
+{
+  // undo as much of UR_setup as was done
+  if (q->fd < 0)
+    return;
+  if (q->sqes != MAP_FAILED)
+    munmap (q->sqes,q->sqesSize);
+  if (q->queues != MAP_FAILED)
+    munmap (q->queues,q->queuesSize);
+  close (q->fd);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// UR_enter
+//
+///////////////////////////////////////////////////////////////////////////////
+static int UR_enter (int fd, unsigned submit, unsigned wait, unsigned flags,
+		     struct io_uring_getevents_arg *arg)
+{
+  // submit requests to io_uring fd and wait for completions, as
+  // io_uring_enter, giving it arg if there is one
+  return syscall (SYS_io_uring_enter,fd,submit,wait,flags,arg,
+		  arg ? sizeof(*arg) : 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// UR_register
+//
+///////////////////////////////////////////////////////////////////////////////
+static int UR_register (int fd, unsigned op, void *arg, unsigned count)
+{
+  return syscall (SYS_io_uring_register,fd,op,arg,count);
+}
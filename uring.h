@@ -0,0 +1,105 @@
+//
+// File: uring.h
+//
+// Author: Hamza Sultan Khan Niazi
+//
+// Description: Datagram sockets served through an io_uring, so that most
+// datagrams in and out don't cost a system call each.  The kernel is
+// driven directly, without liburing, and must be 6.1 or later.
+//
+// A ring keeps a multishot receive posted on each socket it is given.
+// The ring provides the kernel with a set of buffers, and each datagram
+// that comes in is put in one of them and reported with a completion, for
+// as long as buffers are there; the receive is posted again if it ever
+// ends.  Datagrams to send are written into slots of a send pool and
+// queued, and everything queued goes to the kernel together when the
+// ring is submitted.  Where the kernel lets us, the send pool is
+// registered with it, and datagrams of UR_ZERO_COPY_MIN bytes or more are
+// sent from their slots without being copied, the slot being held until
+// the kernel is done with it.  As with a socket, a datagram that finds no
+// room, here no free slot, is dropped.
+//
+// A ring is used by one thread at a time, except that one thread may wait
+// in UR_wait while others use it.
+//
+// The following functions are defined:
+//    UR_open (int recvSize, int sendSize)
+//    UR_recv (struct UR_ring *ring, int sock, int tag)
+//    UR_reserve (struct UR_ring *ring, int length)
+//    UR_send (struct UR_ring *ring, int sock, const struct sockaddr_in *to,
+//             int length)
+//    UR_submit (struct UR_ring *ring)
+//    UR_wait (struct UR_ring *ring)
+//    UR_stop (struct UR_ring *ring)
+//    UR_next (struct UR_ring *ring, struct UR_datagram *datagram)
+//    UR_done (struct UR_ring *ring, struct UR_datagram *datagram)
+//    UR_close (struct UR_ring *ring)
+//
+#ifndef _URING_H
+#define _URING_H
+
+#include <netinet/in.h>  // struct sockaddr_in
+
+// buffers the kernel is given to receive into and slots in the send pool,
+// each a power of two; the most sockets a ring receives on; and the
+// smallest datagram worth sending without a copy
+#define UR_BUFFERS 256
+#define UR_SLOTS 256
+#define UR_MAX_SOCKETS 16
+#define UR_ZERO_COPY_MIN 4096
+
+struct UR_ring;
+
+// a datagram that came in, lying in one of the ring's buffers
+struct UR_datagram {
+  int tag;                     // the tag of the socket it came in on
+  unsigned char *data;
+  int length;
+  struct sockaddr_in from;
+  int buffer;                  // which buffer it's in
+};
+
+struct UR_ring *UR_open (int recvSize, int sendSize);
+// opens a ring taking datagrams of up to recvSize bytes in, and sending
+// datagrams of up to sendSize bytes.  Returns null if the kernel can't
+// give us one.
+
+int UR_recv (struct UR_ring *ring, int sock, int tag);
+// queues the receive that takes the datagrams coming in on socket sock,
+// which are reported with the given tag.  The thread that submits it
+// should be the one that takes the datagrams, since the kernel finishes
+// each receive in the thread that asked for it.  Returns -1 if the ring
+// receives on too many sockets already.
+
+unsigned char *UR_reserve (struct UR_ring *ring, int length);
+// returns the slot that the next length byte datagram sent is to be
+// written into, or null if there's no free slot or length is more than
+// the ring's sendSize.
+
+void UR_send (struct UR_ring *ring, int sock, const struct sockaddr_in *to,
+	      int length);
+// queues the length byte datagram written into the slot last reserved, to
+// be sent from socket sock to address to.
+
+void UR_submit (struct UR_ring *ring);
+// hands everything queued to the kernel, in one system call.
+
+void UR_wait (struct UR_ring *ring);
+// waits until there's something for UR_next.  It may return early.
+
+void UR_stop (struct UR_ring *ring);
+// makes the thread waiting in UR_wait, and every later call to it, return
+// soon whether or not there's anything for UR_next.
+
+int UR_next (struct UR_ring *ring, struct UR_datagram *datagram);
+// fills in datagram with the next datagram that has come in, and returns
+// true, or returns false if there's none yet.  Datagrams sent are done
+// with on the way, and receives that have ended are queued again.  The
+// datagram stays in its buffer until UR_done.
+
+void UR_done (struct UR_ring *ring, struct UR_datagram *datagram);
+// gives the buffer of a datagram returned by UR_next back to the kernel.
+
+void UR_close (struct UR_ring *ring);
+// closes a ring.  No thread may be using it, or waiting in UR_wait.
+#endif